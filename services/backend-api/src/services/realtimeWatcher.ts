@@ -1,9 +1,12 @@
 import { watch } from "node:fs";
-import { stat, readFile } from "node:fs/promises";
+import { stat, readFile, open } from "node:fs/promises";
 import type { Session } from "../types/session";
 import { MongoStorageService } from "./mongoStorage";
 import type { CapturedSession } from "./fileStorage";
 
+// Most of the NDJSON output read into memory at once
+const NDJSON_CHUNK_BYTES = 4 * 1024 * 1024;
+
 export type RealtimeEvent =
   | { type: "session_new"; data: Session }
   | { type: "session_update"; data: Session }
@@ -17,6 +20,8 @@ export class RealtimeWatcher {
   private watchInterval: Timer | null = null;
   private mongoStorage: MongoStorageService;
   private syncedSessionIds: Set<string> = new Set();
+  // Byte offset just past the last complete line read from the NDJSON output
+  private ndjsonOffset: number = 0;
 
   constructor(dataDir: string, mongoStorage: MongoStorageService) {
     this.dataDir = dataDir;
@@ -68,6 +73,24 @@ export class RealtimeWatcher {
   }
 
   private async checkForUpdates() {
+    // The agent's ndjson output is tailed; the json document is re-read
+    // whole, so it is only used when there is no ndjson file
+    try {
+      const added = await this.tailNdjson(`${this.dataDir}/captured_sessions.ndjson`);
+      if (added > 0) {
+        this.broadcast({
+          type: "stats_update",
+          data: { timestamp: Date.now() },
+        });
+      }
+      return;
+    } catch (error) {
+      if ((error as any).code !== 'ENOENT') {
+        console.error("Error tailing captured_sessions.ndjson:", error);
+        return;
+      }
+    }
+
     try {
       const filePath = `${this.dataDir}/captured_sessions.json`;
       const stats = await stat(filePath);
@@ -91,6 +114,61 @@ export class RealtimeWatcher {
     }
   }
 
+  // Reads the lines appended since the last call, one session per line.
+  // Only whole lines are consumed; a batch still being written is picked up
+  // on the next tick. The file is read in bounded chunks, since it keeps
+  // growing across agent runs and is re-read from the start when the
+  // watcher restarts. Returns the number of requests synced.
+  private async tailNdjson(filePath: string): Promise<number> {
+    const handle = await open(filePath, "r");
+    try {
+      const { size } = await handle.stat();
+      if (size < this.ndjsonOffset) {
+        // Truncated or replaced: start over (synced ids prevent duplicates)
+        this.ndjsonOffset = 0;
+      }
+
+      let added = 0;
+      let chunkBytes = NDJSON_CHUNK_BYTES;
+      let buffer = Buffer.alloc(0);
+      while (this.ndjsonOffset < size) {
+        const length = Math.min(chunkBytes, size - this.ndjsonOffset);
+        if (buffer.length < length) {
+          buffer = Buffer.alloc(length);
+        }
+        const { bytesRead } = await handle.read(buffer, 0, length, this.ndjsonOffset);
+        const end = bytesRead > 0 ? buffer.lastIndexOf(0x0a, bytesRead - 1) : -1;
+        if (end < 0) {
+          if (bytesRead < chunkBytes) {
+            break;  // The rest is a line still being written
+          }
+          // A session longer than the chunk: read more of it next time round
+          chunkBytes *= 2;
+          continue;
+        }
+
+        const rawSessions: any[] = [];
+        for (const line of buffer.toString("utf-8", 0, end).split("\n")) {
+          if (line.length === 0) {
+            continue;
+          }
+          try {
+            rawSessions.push(JSON.parse(line));
+          } catch (error) {
+            console.error("Skipping malformed line in captured_sessions.ndjson:", error);
+          }
+        }
+
+        added += await this.saveRawSessions(rawSessions);
+        this.ndjsonOffset += end + 1;
+        chunkBytes = NDJSON_CHUNK_BYTES;
+      }
+      return added;
+    } finally {
+      await handle.close();
+    }
+  }
+
   private async syncSessionsToMongo(filePath: string) {
     try {
       const fileContent = await readFile(filePath, "utf-8");
@@ -100,64 +178,75 @@ export class RealtimeWatcher {
         return;
       }
 
-      const transformedSessions: CapturedSession[] = [];
+      await this.saveRawSessions(data.sessions);
+    } catch (error) {
+      console.error("Error syncing sessions to MongoDB:", error);
+    }
+  }
 
-      for (const rawSession of data.sessions) {
-        if (this.syncedSessionIds.has(rawSession.sessionId)) {
-          continue;
-        }
+  // Stores the transactions of sessions not synced before, one document
+  // per request. Returns how many were stored.
+  private async saveRawSessions(rawSessions: any[]): Promise<number> {
+    const transformedSessions: CapturedSession[] = [];
+    const completedSessionIds: string[] = [];
 
-        if (!rawSession.transactions || rawSession.transactions.length === 0) {
-          continue;
-        }
+    for (const rawSession of rawSessions) {
+      if (this.syncedSessionIds.has(rawSession.sessionId)) {
+        continue;
+      }
 
-        for (let i = 0; i < rawSession.transactions.length; i++) {
-          const txn = rawSession.transactions[i];
-          const uniqueSessionId = `${rawSession.sessionId}-txn-${i}`;
+      if (!rawSession.transactions || rawSession.transactions.length === 0) {
+        continue;
+      }
 
-          if (this.syncedSessionIds.has(uniqueSessionId)) {
-            continue;
-          }
+      for (let i = 0; i < rawSession.transactions.length; i++) {
+        const txn = rawSession.transactions[i];
+        const uniqueSessionId = `${rawSession.sessionId}-txn-${i}`;
 
-          const transformedSession: CapturedSession = {
-            sessionId: uniqueSessionId,
-            timestamp: new Date(txn.requestTime * 1000).toISOString(),
-            sourceIp: rawSession.clientIp,
-            sourcePort: rawSession.clientPort,
-            destIp: rawSession.serverIp,
-            destPort: rawSession.serverPort,
-            request: {
-              method: txn.request.method,
-              uri: txn.request.uri,
-              version: txn.request.version,
-              headers: this.transformHeaders(txn.request.headers),
-              body: txn.request.body
-            },
-            response: txn.response ? {
-              version: txn.response.version,
-              statusCode: txn.response.statusCode,
-              statusMessage: txn.response.statusMessage,
-              headers: this.transformHeaders(txn.response.headers),
-              body: txn.response.body
-            } : undefined
-          };
-
-          transformedSessions.push(transformedSession);
+        if (this.syncedSessionIds.has(uniqueSessionId)) {
+          continue;
         }
 
-        this.syncedSessionIds.add(rawSession.sessionId);
-      }
+        const transformedSession: CapturedSession = {
+          sessionId: uniqueSessionId,
+          timestamp: new Date(txn.requestTime * 1000).toISOString(),
+          sourceIp: rawSession.clientIp,
+          sourcePort: rawSession.clientPort,
+          destIp: rawSession.serverIp,
+          destPort: rawSession.serverPort,
+          request: {
+            method: txn.request.method,
+            uri: txn.request.uri,
+            version: txn.request.version,
+            headers: this.transformHeaders(txn.request.headers),
+            body: txn.request.body
+          },
+          response: txn.response ? {
+            version: txn.response.version,
+            statusCode: txn.response.statusCode,
+            statusMessage: txn.response.statusMessage,
+            headers: this.transformHeaders(txn.response.headers),
+            body: txn.response.body
+          } : undefined
+        };
 
-      if (transformedSessions.length > 0) {
-        await this.mongoStorage.saveSessions(transformedSessions);
-        transformedSessions.forEach(session => {
-          this.syncedSessionIds.add(session.sessionId);
-        });
-        console.log(`Synced ${transformedSessions.length} new HTTP requests to MongoDB (Total synced: ${this.syncedSessionIds.size})`);
+        transformedSessions.push(transformedSession);
       }
-    } catch (error) {
-      console.error("Error syncing sessions to MongoDB:", error);
+
+      completedSessionIds.push(rawSession.sessionId);
     }
+
+    // Marked as synced only once stored, so a failed save is retried
+    if (transformedSessions.length > 0) {
+      await this.mongoStorage.saveSessions(transformedSessions);
+      transformedSessions.forEach(session => {
+        this.syncedSessionIds.add(session.sessionId);
+      });
+      console.log(`Synced ${transformedSessions.length} new HTTP requests to MongoDB (Total synced: ${this.syncedSessionIds.size})`);
+    }
+    completedSessionIds.forEach(id => this.syncedSessionIds.add(id));
+
+    return transformedSessions.length;
   }
 
   private transformHeaders(headers: Record<string, string> | undefined): Array<{name: string, value: string}> {
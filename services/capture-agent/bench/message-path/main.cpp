@@ -0,0 +1,143 @@
+// message-path: hands parsed messages from the parser to their transaction
+// the way the capture path does now (one copy into the payload buffer, moves
+// after that) and the way it did with by-value messages, whose body was
+// copied again at every hop that stored or read it.
+
+#include "rewind/capture/Session.h"
+#include "rewind/parsers/HttpStreamParser.h"
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    std::string makeRequest(size_t bodySize) {
+        std::string body(bodySize, 'x');
+        for (size_t i = 0; i < bodySize; i += 64) {
+            body[i] = static_cast<char>('a' + (i / 64) % 26);
+        }
+
+        return "POST /api/v1/upload HTTP/1.1\r\n"
+            "Host: api.example.com\r\n"
+            "User-Agent: bench/1.0\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Content-Length: " + std::to_string(bodySize) + "\r\n"
+            "\r\n" + body;
+    }
+
+    // The message as it used to be: owning strings returned by value
+    struct LegacyMessage {
+        std::string method;
+        std::string uri;
+        std::string version;
+        std::map<std::string, std::string> headers;
+        std::string body;
+
+        std::string getBody() const { return body; }
+    };
+
+    LegacyMessage parseLegacy(const std::string& data) {
+        LegacyMessage msg;
+        size_t lineEnd = data.find("\r\n");
+        size_t firstSpace = data.find(' ');
+        size_t secondSpace = data.find(' ', firstSpace + 1);
+        msg.method = data.substr(0, firstSpace);
+        msg.uri = data.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+        msg.version = data.substr(secondSpace + 1, lineEnd - secondSpace - 1);
+
+        size_t headersEnd = data.find("\r\n\r\n");
+        size_t pos = lineEnd + 2;
+        while (pos < headersEnd) {
+            size_t end = data.find("\r\n", pos);
+            size_t colon = data.find(':', pos);
+            msg.headers[data.substr(pos, colon - pos)] = data.substr(colon + 2, end - colon - 2);
+            pos = end + 2;
+        }
+
+        msg.body = data.substr(headersEnd + 4);
+        return msg;
+    }
+
+    struct LegacyTransaction {
+        LegacyMessage request;
+        void setRequest(const LegacyMessage& req) { request = req; }
+    };
+
+    // Parser -> callback -> session manager -> transaction, all by const
+    // reference, then one body read when the session is written out
+    size_t runLegacy(const std::string& wire, size_t iterations) {
+        std::vector<LegacyTransaction> transactions(1);
+        size_t bytes = 0;
+
+        std::function<void(const LegacyMessage&)> addMessage = [&](const LegacyMessage& msg) {
+            transactions.back().setRequest(msg);
+        };
+        std::function<void(const LegacyMessage&)> callback = [&](const LegacyMessage& msg) {
+            addMessage(msg);
+        };
+
+        for (size_t i = 0; i < iterations; i++) {
+            callback(parseLegacy(wire));
+            bytes += transactions.back().request.getBody().size();
+        }
+        return bytes;
+    }
+
+    // The current path: the message is moved at every hop
+    size_t runMoved(const std::string& wire, size_t iterations) {
+        rwd::HttpStreamParser parser;
+        std::vector<rwd::HttpTransaction> transactions(1);
+        size_t bytes = 0;
+
+        std::function<void(rwd::HttpMessage&&)> addMessage = [&](rwd::HttpMessage&& msg) {
+            transactions.back().setRequest(std::move(msg), 0.0);
+        };
+        std::function<void(rwd::HttpMessage&&)> callback = [&](rwd::HttpMessage&& msg) {
+            addMessage(std::move(msg));
+        };
+        auto onMessage = [&](rwd::HttpMessage&& msg) {
+            callback(std::move(msg));
+        };
+
+        for (size_t i = 0; i < iterations; i++) {
+            parser.feed(wire.data(), wire.size(), onMessage);
+            bytes += transactions.back().getRequest().getBody().size();
+        }
+        return bytes;
+    }
+
+    template <typename Fn>
+    double measure(const std::string& wire, size_t iterations, Fn&& fn) {
+        auto start = Clock::now();
+        size_t bytes = fn(wire, iterations);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Keep the work observable so it is not optimised away
+        if (bytes == 0) {
+            std::fprintf(stderr, "no bodies delivered\n");
+        }
+        return iterations / seconds;
+    }
+
+}
+
+int main() {
+    std::printf("%10s %14s %14s %8s\n", "body", "legacy msg/s", "moved msg/s", "speedup");
+
+    for (size_t size : {1024, 16384, 65536, 262144, 1048576}) {
+        std::string wire = makeRequest(size);
+        size_t iterations = (4ull * 1024 * 1024 * 1024) / wire.size();
+
+        double legacy = measure(wire, iterations, runLegacy);
+        double moved = measure(wire, iterations, runMoved);
+
+        std::printf("%10zu %14.0f %14.0f %7.2fx\n", size, legacy, moved, moved / legacy);
+    }
+
+    return 0;
+}
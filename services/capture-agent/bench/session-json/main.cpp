@@ -0,0 +1,240 @@
+// session-json: writes the same closed sessions out four ways and reports
+// throughput and how much the peak RSS grew while doing it:
+//   dom-all          one nlohmann::json document holding every session,
+//                    dumped at the end (how the agent used to write on exit)
+//   dom-per-session  toJson().dump() per session into an NDJSON batch
+//   writer           Session::writeJson into one reused buffer, as the sinks
+//                    do now
+//   segment          the binary segment encoding (output_format: segment),
+//                    1 MB blocks, deflated columns when built with zlib
+// Each mode runs in its own forked process so the peaks do not mix.
+//
+//   bench-session-json [sessions]   (default 100000)
+
+#include "rewind/capture/Session.h"
+#include "rewind/output/JsonWriter.h"
+#include "rewind/output/SegmentEncoder.h"
+#include "rewind/parsers/HttpStreamParser.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Same size as NdjsonOptions::flushBytes
+    constexpr size_t kBatchBytes = 64 * 1024;
+
+    std::string makeRequest(size_t i) {
+        std::string uri = "/api/v1/orders/" + std::to_string(i) + "?expand=items&q=caf%C3%A9";
+        if (i % 3 != 0) {
+            return "GET " + uri + " HTTP/1.1\r\n"
+                "Host: shop.example.com\r\n"
+                "User-Agent: Mozilla/5.0 (X11; Linux x86_64) bench/1.0\r\n"
+                "Accept: application/json\r\n"
+                "Accept-Encoding: identity\r\n"
+                "Cookie: session=abc123; theme=\"dark\"\r\n"
+                "\r\n";
+        }
+
+        std::string body = "{\"order\":" + std::to_string(i) +
+            ",\"note\":\"leave at the door\\nring twice\",\"items\":[1,2,3]}";
+        return "POST " + uri + " HTTP/1.1\r\n"
+            "Host: shop.example.com\r\n"
+            "User-Agent: Mozilla/5.0 (X11; Linux x86_64) bench/1.0\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "\r\n" + body;
+    }
+
+    std::string makeResponse(size_t i) {
+        std::string body;
+        std::string contentType;
+        if (i % 5 == 0) {
+            // Long enough to be written as a preview
+            contentType = "text/html; charset=utf-8";
+            body = "<!doctype html><html><head><title>Order</title></head><body>";
+            while (body.size() < 700) {
+                body += "<p class=\"line\">\tItem été " + std::to_string(body.size()) + "</p>\n";
+            }
+            body += "</body></html>";
+        }
+        else {
+            contentType = "application/json";
+            body = "{\"id\":" + std::to_string(i) + ",\"status\":\"shipped\",\"total\":42.5,"
+                "\"customer\":{\"name\":\"Zoë \\\"Z\\\" Müller\",\"email\":\"zoe@example.com\"},"
+                "\"items\":[{\"sku\":\"A-1\",\"qty\":2},{\"sku\":\"B-7\",\"qty\":1}]}";
+        }
+
+        return "HTTP/1.1 200 OK\r\n"
+            "Content-Type: " + contentType + "\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Cache-Control: no-store\r\n"
+            "Set-Cookie: a=1; Path=/\r\n"
+            "Set-Cookie: b=2; Path=/\r\n"
+            "X-Request-Id: 7f3c9a2e-" + std::to_string(i) + "\r\n"
+            "\r\n" + body;
+    }
+
+    std::vector<std::unique_ptr<rwd::Session>> buildSessions(size_t count) {
+        std::vector<std::unique_ptr<rwd::Session>> sessions;
+        sessions.reserve(count);
+
+        rwd::HttpStreamParser requests;
+        rwd::HttpStreamParser responses;
+        double now = 1700000000.0;
+
+        for (size_t i = 0; i < count; i++) {
+            rwd::FlowKey flow;
+            flow.clientAddress = {10, 0, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)};
+            flow.serverAddress = {192, 168, 1, 10};
+            flow.clientPort = static_cast<uint16_t>(32768 + i % 28000);
+            flow.serverPort = 443;
+
+            auto session = std::make_unique<rwd::Session>(flow);
+            size_t transactions = i % 4 == 0 ? 2 : 1;
+            for (size_t t = 0; t < transactions; t++) {
+                std::string request = makeRequest(i + t);
+                requests.feed(request.data(), request.size(), [&](rwd::HttpMessage&& msg) {
+                    session->addRequest(std::move(msg), now);
+                });
+
+                std::string response = makeResponse(i + t);
+                responses.feed(response.data(), response.size(), [&](rwd::HttpMessage&& msg) {
+                    session->addResponse(std::move(msg), now + 0.012);
+                });
+                now += 0.001;
+            }
+            session->close();
+            sessions.push_back(std::move(session));
+        }
+
+        return sessions;
+    }
+
+    size_t runDomAll(const std::vector<std::unique_ptr<rwd::Session>>& sessions) {
+        nlohmann::json document;
+        document["sessions"] = nlohmann::json::array();
+        for (const auto& session : sessions) {
+            document["sessions"].push_back(session->toJson());
+        }
+        return document.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace).size();
+    }
+
+    size_t runDomPerSession(const std::vector<std::unique_ptr<rwd::Session>>& sessions) {
+        std::string batch;
+        size_t bytes = 0;
+        for (const auto& session : sessions) {
+            batch += session->toJson().dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            batch += '\n';
+            if (batch.size() >= kBatchBytes) {
+                bytes += batch.size();
+                batch.clear();
+            }
+        }
+        return bytes + batch.size();
+    }
+
+    size_t runWriter(const std::vector<std::unique_ptr<rwd::Session>>& sessions) {
+        std::string rendered;
+        std::string batch;
+        size_t bytes = 0;
+        for (const auto& session : sessions) {
+            rendered.clear();
+            rwd::JsonWriter writer(rendered);
+            session->writeJson(writer);
+
+            batch += rendered;
+            batch += '\n';
+            if (batch.size() >= kBatchBytes) {
+                bytes += batch.size();
+                batch.clear();
+            }
+        }
+        return bytes + batch.size();
+    }
+
+    size_t runSegment(const std::vector<std::unique_ptr<rwd::Session>>& sessions) {
+        rwd::SegmentSession rendered;
+        rwd::SegmentBlockEncoder encoder;
+        rwd::SegmentBlockInfo info;
+        std::string block;
+        size_t bytes = 0;
+        for (const auto& session : sessions) {
+            rendered.render(*session, rwd::BodyOptions());
+            encoder.add(rendered);
+            if (encoder.getBufferedBytes() >= 1024 * 1024) {
+                block.clear();
+                encoder.finish(block, info);
+                bytes += block.size();
+            }
+        }
+        block.clear();
+        encoder.finish(block, info);
+        return bytes + block.size();
+    }
+
+    long peakRssKb() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    using Mode = size_t (*)(const std::vector<std::unique_ptr<rwd::Session>>&);
+
+    // Runs one mode in a child so its peak RSS is measured on its own
+    void runMode(const char* name, Mode mode, const std::vector<std::unique_ptr<rwd::Session>>& sessions) {
+        std::fflush(stdout);
+        pid_t child = fork();
+        if (child < 0) {
+            std::perror("fork");
+            return;
+        }
+
+        if (child == 0) {
+            long baseline = peakRssKb();
+            auto start = Clock::now();
+            size_t bytes = mode(sessions);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            long growth = peakRssKb() - baseline;
+
+            std::printf("%-16s %12.0f %10.1f %12.1f %14ld\n", name,
+                sessions.size() / seconds,
+                bytes / seconds / (1024.0 * 1024.0),
+                bytes / (1024.0 * 1024.0),
+                growth / 1024);
+            std::fflush(stdout);
+            _exit(0);
+        }
+
+        int status = 0;
+        waitpid(child, &status, 0);
+    }
+
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    if (count == 0) {
+        std::fprintf(stderr, "usage: %s [sessions]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<rwd::Session>> sessions = buildSessions(count);
+    std::printf("%zu sessions built, peak RSS %ld MB\n\n", sessions.size(), peakRssKb() / 1024);
+
+    std::printf("%-16s %12s %10s %12s %14s\n", "mode", "sessions/s", "MB/s", "output MB", "peak RSS +MB");
+    runMode("dom-all", runDomAll, sessions);
+    runMode("dom-per-session", runDomPerSession, sessions);
+    runMode("writer", runWriter, sessions);
+    runMode("segment", runSegment, sessions);
+
+    return 0;
+}
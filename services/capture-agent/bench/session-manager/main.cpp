@@ -0,0 +1,118 @@
+// session-manager: hands parsed messages to one SessionManager from 1, 2, 4,
+// ... threads at once, each thread on its own flows as the capture workers
+// are, and reports how the message rate scales. Every flow carries one
+// request and one response and is then ended, so sessions are created,
+// filled and written out (to no sink) at the rate a busy agent would.
+//
+//   bench-session-manager [flows per thread] [max threads]
+//                         (defaults 50000 and the hardware thread count)
+
+#include "rewind/capture/SessionManager.h"
+#include "rewind/parsers/HttpStreamParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    const std::string kRequest =
+        "GET /api/v1/orders/42?expand=items HTTP/1.1\r\n"
+        "Host: shop.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) bench/1.0\r\n"
+        "Accept: application/json\r\n"
+        "\r\n";
+
+    const std::string kResponse =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 27\r\n"
+        "\r\n"
+        "{\"id\":42,\"status\":\"ready\"}";
+
+    struct Flow {
+        rwd::FlowKey key;
+        rwd::HttpMessage request;
+        rwd::HttpMessage response;
+    };
+
+    // Parsing happens up front so only the session path is timed
+    std::vector<Flow> buildFlows(size_t thread, size_t count) {
+        std::vector<Flow> flows(count);
+        rwd::HttpStreamParser requests;
+        rwd::HttpStreamParser responses;
+
+        for (size_t i = 0; i < count; i++) {
+            Flow& flow = flows[i];
+            flow.key.clientAddress = {10, static_cast<uint8_t>(thread),
+                static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)};
+            flow.key.serverAddress = {192, 168, 1, 10};
+            flow.key.clientPort = static_cast<uint16_t>(32768 + (i >> 16));
+            flow.key.serverPort = 80;
+
+            requests.feed(kRequest.data(), kRequest.size(), [&flow](rwd::HttpMessage&& msg) {
+                flow.request = std::move(msg);
+            });
+            responses.expectResponse("GET");
+            responses.feed(kResponse.data(), kResponse.size(), [&flow](rwd::HttpMessage&& msg) {
+                flow.response = std::move(msg);
+            });
+        }
+
+        return flows;
+    }
+
+    void runFlows(rwd::SessionManager& sessions, std::vector<Flow>& flows, size_t sourceId) {
+        double now = 1700000000.0;
+        for (Flow& flow : flows) {
+            sessions.addMessage(std::move(flow.request), flow.key, true, now, sourceId);
+            sessions.addMessage(std::move(flow.response), flow.key, false, now + 0.001, sourceId);
+            sessions.endSession(flow.key, sourceId, now + 0.002);
+            now += 0.0001;
+        }
+    }
+
+}
+
+int main(int argc, char** argv) {
+    size_t perThread = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000;
+    size_t maxThreads = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+        : std::max<size_t>(1, std::thread::hardware_concurrency());
+    if (perThread == 0 || perThread > 65536 * 256 || maxThreads == 0 || maxThreads > 256) {
+        std::fprintf(stderr, "usage: %s [flows per thread] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-8s %14s %10s\n", "threads", "messages/s", "speedup");
+    double single = 0.0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        std::vector<std::vector<Flow>> work;
+        for (size_t t = 0; t < threads; t++) {
+            work.push_back(buildFlows(t, perThread));
+        }
+
+        rwd::SessionManager sessions;
+        std::vector<std::thread> workers;
+        auto start = Clock::now();
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&sessions, &work, t] { runFlows(sessions, work[t], 0); });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        double rate = threads * perThread * 2 / seconds;
+        if (threads == 1) {
+            single = rate;
+        }
+        std::printf("%-8zu %14.0f %9.2fx\n", threads, rate, rate / single);
+    }
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+// utf8: compares Utf8Validator implementations with the byte-at-a-time
+// check HttpMessage used to do, on ASCII, mixed and invalid text bodies.
+
+#include "rewind/parsers/Utf8Validator.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // What HttpMessage::toJson used before the validator (lenient: accepts
+    // overlong forms and surrogates)
+    bool isValidUtf8Legacy(std::string_view str) {
+        for (size_t i = 0; i < str.length(); ) {
+            unsigned char c = str[i];
+
+            if (c <= 0x7F) {
+                i++;
+                continue;
+            }
+
+            if (c >= 0xC0 && c <= 0xDF) {
+                if (i + 1 >= str.length()) return false;
+                if ((str[i + 1] & 0xC0) != 0x80) return false;
+                i += 2;
+                continue;
+            }
+
+            if (c >= 0xE0 && c <= 0xEF) {
+                if (i + 2 >= str.length()) return false;
+                if ((str[i + 1] & 0xC0) != 0x80) return false;
+                if ((str[i + 2] & 0xC0) != 0x80) return false;
+                i += 3;
+                continue;
+            }
+
+            if (c >= 0xF0 && c <= 0xF7) {
+                if (i + 3 >= str.length()) return false;
+                if ((str[i + 1] & 0xC0) != 0x80) return false;
+                if ((str[i + 2] & 0xC0) != 0x80) return false;
+                if ((str[i + 3] & 0xC0) != 0x80) return false;
+                i += 4;
+                continue;
+            }
+
+            return false;
+        }
+
+        return true;
+    }
+
+    // JSON API response, ASCII only
+    std::string makeAscii(size_t targetSize) {
+        std::string text;
+        size_t n = 0;
+        while (text.size() < targetSize) {
+            text += "{\"id\":" + std::to_string(n++) +
+                ",\"name\":\"widget\",\"tags\":[\"alpha\",\"beta\"],\"price\":12.50},";
+        }
+        text.resize(targetSize);
+        return text;
+    }
+
+    // Mostly ASCII with accented, CJK and emoji text mixed in
+    std::string makeMixed(size_t targetSize) {
+        std::string text;
+        size_t n = 0;
+        while (text.size() < targetSize) {
+            text += "{\"id\":" + std::to_string(n++) +
+                ",\"city\":\"Z\xC3\xBCrich\",\"greeting\":\"\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF\","
+                "\"mood\":\"\xF0\x9F\x99\x82\",\"note\":\"plain ascii padding here\"},";
+        }
+        while (text.size() > targetSize) {
+            text.pop_back();
+        }
+        // Don't leave a cut sequence at the end
+        while (!text.empty() && (static_cast<unsigned char>(text.back()) & 0x80)) {
+            text.pop_back();
+        }
+        return text;
+    }
+
+    // ASCII with one stray Latin-1 byte near the end, the common way a
+    // "text" body turns out not to be UTF-8
+    std::string makeInvalid(size_t targetSize) {
+        std::string text = makeAscii(targetSize);
+        text[targetSize - targetSize / 16] = '\xE9';
+        return text;
+    }
+
+    template <typename Fn>
+    double measure(const std::string& text, size_t iterations, Fn&& fn) {
+        size_t valid = 0;
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            valid += fn(text) ? 1 : 0;
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Keep the work observable so it is not optimised away
+        if (valid == iterations + 1) {
+            std::fprintf(stderr, "impossible\n");
+        }
+        return (text.size() * iterations) / seconds / (1024.0 * 1024.0);
+    }
+
+}
+
+int main() {
+    using rwd::Utf8Validator;
+
+    const Utf8Validator::Implementation implementations[] = {
+        Utf8Validator::Implementation::Scalar,
+        Utf8Validator::Implementation::Sse42,
+        Utf8Validator::Implementation::Avx2
+    };
+
+    struct Input {
+        const char* name;
+        std::string (*make)(size_t);
+    };
+    const Input inputs[] = {
+        {"ascii", makeAscii},
+        {"mixed", makeMixed},
+        {"invalid", makeInvalid}
+    };
+
+    std::printf("runtime selection: %s\n\n", rwd::simdLevelName(rwd::detectSimdLevel()));
+    std::printf("%8s %8s %12s", "input", "size", "legacy MB/s");
+    for (auto impl : implementations) {
+        std::printf(" %11s", rwd::simdLevelName(impl));
+    }
+    std::printf("\n");
+
+    for (const Input& input : inputs) {
+        for (size_t size : {256, 4096, 65536}) {
+            std::string text = input.make(size);
+            size_t iterations = (512 * 1024 * 1024) / text.size();
+
+            std::printf("%8s %8zu %12.0f", input.name, text.size(),
+                measure(text, iterations / 8, [](const std::string& t) { return isValidUtf8Legacy(t); }));
+
+            for (auto impl : implementations) {
+                if (!rwd::isSimdLevelSupported(impl)) {
+                    std::printf(" %11s", "n/a");
+                    continue;
+                }
+                std::printf(" %11.0f", measure(text, iterations, [impl](const std::string& t) {
+                    return Utf8Validator::validate(t, impl);
+                }));
+            }
+            std::printf("\n");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "rewind/capture/FlowKey.h"
+#include "rewind/capture/FlowTable.h"
+#include "rewind/capture/TimerWheel.h"
+#include "rewind/parsers/HttpMessage.h"
+#include "rewind/parsers/HttpStreamParser.h"
+#include <TcpReassembly.h>
+#include <RawPacket.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace rwd {
+
+    // The message is handed over; receivers move it into its final storage
+    using HttpMessageCallback = std::function<void(
+        HttpMessage&&,
+        const FlowKey& flow,
+        bool isRequest,
+        double timestamp   // Capture time of the packet that completed the message
+    )>;
+
+    // Called once a connection has ended, after its last messages
+    using FlowEndCallback = std::function<void(const FlowKey& flow, double timestamp)>;
+
+    // Seconds without a packet before a connection is dropped, by TCP state
+    struct FlowTimeouts {
+        double handshake = 10.0;     // Only SYN / SYN-ACK seen so far
+        double established = 300.0;
+        double halfClosed = 30.0;    // One side has sent FIN
+    };
+
+    // Owns the TCP reassembly and per-connection state for one shard of flows.
+    // In inline mode packets are processed on the caller's thread; once start()
+    // is called, packets are queued by the capture thread and processed here.
+    class CaptureWorker {
+    public:
+        CaptureWorker(size_t id, HttpMessageCallback callback, const BodyLimits& bodyLimits = BodyLimits(),
+            const FlowTimeouts& timeouts = FlowTimeouts(), size_t maxQueueDepth = 65536);
+        ~CaptureWorker();
+
+        CaptureWorker(const CaptureWorker&) = delete;
+        CaptureWorker& operator=(const CaptureWorker&) = delete;
+
+        // Must be set before packets are processed
+        void setFlowEndCallback(FlowEndCallback callback) { flowEndCallback_ = std::move(callback); }
+        // Replaying a file: a flow that resumes on a key the reassembly still
+        // holds as closed waits for it to be purged instead of being dropped
+        void setOffline(bool offline) { offline_ = offline; }
+
+        void start();
+        void stop();
+
+        // Inline mode: reassemble the packet on the calling thread
+        void processPacket(pcpp::RawPacket* rawPacket);
+
+        // Sharded mode: copy the packet into this worker's queue. A full
+        // queue drops the packet (live capture cannot wait), or with block
+        // set waits for room (an offline replay must not lose packets).
+        bool enqueue(const pcpp::RawPacket& rawPacket, bool block = false);
+
+        // Sharded mode: moves this worker's packet clock to the capture
+        // time of the latest packet on any shard, once its queue is drained
+        void tick(double packetTime);
+
+        // Ends every connection still open so its parsers are finished and
+        // close-delimited messages are delivered. Called on the worker thread
+        // once its queue has drained; in inline mode, by stop().
+        void closeAllConnections();
+
+        size_t getId() const { return id_; }
+        int getHttpMessageCount() const { return httpMessageCount_.load(std::memory_order_relaxed); }
+        int getDroppedPacketCount() const { return droppedPacketCount_.load(std::memory_order_relaxed); }
+        size_t getExpiredFlowCount() const { return expiredFlowCount_.load(std::memory_order_relaxed); }
+
+    private:
+        static void onTcpMessageReadyStatic(int8_t side, const pcpp::TcpStreamData& tcpData, void* userCookie);
+        static void onTcpConnectionStartStatic(const pcpp::ConnectionData& connectionData, void* userCookie);
+        static void onTcpConnectionEndStatic(const pcpp::ConnectionData& connectionData, pcpp::TcpReassembly::ConnectionEndReason reason, void* userCookie);
+
+        struct ConnectionInfo {
+            FlowKey flow;
+            double lastTimestamp = 0.0;
+            // One incremental parser per direction, indexed by reassembly side
+            HttpStreamParser parsers[2];
+            bool sniffed = false;          // Payload has been classified
+            bool synSeen = false;          // The connection was captured from its start
+            bool tunnelRequested = false;  // A CONNECT request was seen
+            bool nonHttp = false;          // Skip this flow for the rest of its life
+            // Idle expiry, on the packet clock
+            bool established = false;      // Seen a packet without SYN
+            bool finSeen = false;          // One side is closing
+            uint32_t timerToken = 0;       // Identifies the live timer (0 = none)
+        };
+
+        ConnectionInfo& addConnection(uint32_t flowKey, const pcpp::ConnectionData& connData, bool srcIsClient);
+
+        void onTcpMessageReady(int8_t side, const pcpp::TcpStreamData& tcpData);
+        void emitMessage(const ConnectionInfo& conn, HttpMessage&& msg);
+        void markNonHttp(ConnectionInfo& conn, const char* reason);
+        void trackActivity(pcpp::Packet& packet, double timestamp);
+        double idleTimeout(const ConnectionInfo& conn) const;
+        void armTimer(uint32_t flowKey, ConnectionInfo& conn, double deadline);
+        void onTimer(uint32_t flowKey, uint32_t token);
+        void runTimers();
+        void reopenClosedFlow(pcpp::Packet& packet);
+        void endConnection(uint32_t flowKey);
+        void run();
+
+        size_t id_;
+        HttpMessageCallback httpCallback_;
+        FlowEndCallback flowEndCallback_;
+        BodyLimits bodyLimits_;
+        FlowTimeouts timeouts_;
+        std::unique_ptr<pcpp::TcpReassembly> tcpReassembly_;
+        // Keyed by the reassembly's flow key
+        FlowTable<uint32_t, ConnectionInfo> connectionMap_;
+        // Closes idle flows. Each connection has one live timer; older ones
+        // for the same flow key carry a stale token and are ignored.
+        TimerWheel timers_;
+        double packetTime_;   // Capture time of the packet being processed
+        uint32_t timerTokens_;
+        size_t pendingPurge_;  // Closed flows the reassembly still holds
+        // Offline: keys closed by idle expiry and not yet purged, oldest first
+        FlowTable<uint32_t, bool> expiredKeys_;
+        std::deque<uint32_t> expiredOrder_;
+        bool offline_;
+
+        size_t maxQueueDepth_;
+        std::deque<pcpp::RawPacket> queue_;
+        std::mutex queueMutex_;
+        std::condition_variable queueCv_;
+        std::condition_variable queueSpaceCv_;  // Signalled when the worker takes a batch
+        double tickTime_;     // Latest tick not yet applied (0 = none)
+        std::thread thread_;
+        bool running_;
+
+        std::atomic<int> httpMessageCount_;
+        std::atomic<int> droppedPacketCount_;
+        std::atomic<size_t> expiredFlowCount_;
+    };
+
+}
@@ -1,68 +1,78 @@
 #pragma once
 
+#include "rewind/capture/CaptureWorker.h"
+#include "rewind/capture/PacketRing.h"
+#include "rewind/config/Config.h"
 #include "rewind/parsers/HttpMessage.h"
-#include <functional>
-#include <TcpReassembly.h>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
-#include <map>
+#include <thread>
 
 namespace pcpp {
     class PcapLiveDevice;
-    class TcpReassembly;
-    struct TcpStreamData;
+    class IFileReaderDevice;
 }
 
 namespace rwd {
 
-    using HttpMessageCallback = std::function<void(
-        const HttpMessage&,
-        const std::string& clientIp,
-        int clientPort,
-        const std::string& serverIp,
-        int serverPort,
-        bool isRequest
-    )>;
-
     class Capturer {
     public:
-        Capturer();
+        // workerThreads == 0 keeps reassembly and parsing on the capture thread;
+        // otherwise flows are sharded across that many worker threads
+        explicit Capturer(size_t workerThreads = 0, const BodyLimits& bodyLimits = BodyLimits(),
+            const FlowTimeouts& timeouts = FlowTimeouts());
         ~Capturer();
 
         static std::vector<std::string> getAvailableInterfaces();
 
+        static bool isValidFilter(const std::string& bpfFilter);
+
         bool open(size_t interfaceIndex);
-        bool startCapture(HttpMessageCallback callback);
+        // Capture through a memory-mapped AF_PACKET ring instead of libpcap
+        bool openRing(size_t interfaceIndex, const RingConfig& ringConfig);
+        // Read a pcap/pcapng file instead of a live device. replaySpeed == 0
+        // replays as fast as possible; otherwise packet timestamps are honoured,
+        // scaled by the multiplier (2.0 = twice as fast as captured)
+        bool openFile(const std::string& path, double replaySpeed = 0.0);
+        bool setFilter(const std::string& bpfFilter);
+        bool joinFanout(uint16_t groupId);
+        bool startCapture(HttpMessageCallback callback, FlowEndCallback onFlowEnd = nullptr);
         void stopCapture();
         void close();
 
-        int getPacketCount() const { return packetCount_; }
-        int getHttpMessageCount() const { return httpMessageCount_; }
+        // True once an offline replay has consumed the whole file
+        bool isFinished() const { return finished_.load(std::memory_order_acquire); }
+
+        int getPacketCount() const { return packetCount_.load(std::memory_order_relaxed); }
+        int getHttpMessageCount() const;
+        int getDroppedPacketCount() const;
+        size_t getExpiredFlowCount() const;
+        size_t getWorkerCount() const { return workers_.size(); }
+        CaptureStats getCaptureStats() const;
 
     private:
         static void onPacketArrivesStatic(void* rawPacket, void* pcapLiveDevice, void* userCookie);
-        static void onTcpMessageReadyStatic(int8_t side, const pcpp::TcpStreamData& tcpData, void* userCookie);
-        static void onTcpConnectionStartStatic(const pcpp::ConnectionData& connectionData, void* userCookie);
-        static void onTcpConnectionEndStatic(const pcpp::ConnectionData& connectionData, pcpp::TcpReassembly::ConnectionEndReason reason, void* userCookie);
 
-        void onTcpMessageReady(int8_t side, const pcpp::TcpStreamData& tcpData);
-        
-        struct ConnectionInfo {
-            std::string clientIp;
-            int clientPort;
-            std::string serverIp;
-            int serverPort;
-        };
-
-        std::map<uint32_t, ConnectionInfo> connectionMap_;
+        void dispatchPacket(pcpp::RawPacket* rawPacket);
+        void replayFile();
 
         pcpp::PcapLiveDevice* device_;
-        std::unique_ptr<pcpp::TcpReassembly> tcpReassembly_;
-        HttpMessageCallback httpCallback_;
+        std::unique_ptr<PacketRing> ring_;
+        std::unique_ptr<pcpp::IFileReaderDevice> fileReader_;
+        double replaySpeed_;
+        std::thread replayThread_;
+        std::atomic<bool> stopRequested_;
+        std::atomic<bool> finished_;
+        size_t workerThreads_;
+        BodyLimits bodyLimits_;
+        FlowTimeouts timeouts_;
+        std::vector<std::unique_ptr<CaptureWorker>> workers_;
+        double nextWorkerTick_;   // Packet time at which workers are next ticked
 
-        int packetCount_;
-        int httpMessageCount_;
+        std::atomic<int> packetCount_;
     };
 
-}
\ No newline at end of file
+}
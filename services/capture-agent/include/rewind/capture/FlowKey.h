@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <spdlog/fmt/fmt.h>
+
+namespace rwd {
+
+    // Identifies one TCP connection by client and server endpoint, in binary
+    // form. IPv4 addresses occupy the first four bytes of their array.
+    // Addresses are only turned into text when a session is written out or
+    // logged.
+    struct FlowKey {
+        std::array<uint8_t, 16> clientAddress{};
+        std::array<uint8_t, 16> serverAddress{};
+        uint16_t clientPort = 0;
+        uint16_t serverPort = 0;
+        uint8_t ipVersion = 4;
+
+        bool operator==(const FlowKey& other) const = default;
+
+        size_t hash() const;
+
+        std::string clientIp() const;
+        std::string serverIp() const;
+
+        // "client:port->server:port"
+        std::string toString() const;
+
+        // toString() plus "@" and the session's start in microseconds: a
+        // client may reuse its port for a later connection to the same server
+        std::string sessionId(int64_t startMicros) const;
+    };
+
+    struct FlowKeyHash {
+        size_t operator()(const FlowKey& key) const { return key.hash(); }
+    };
+
+}
+
+// Lets log calls take a FlowKey directly, so it is only formatted when the
+// message is actually logged
+template <>
+struct fmt::formatter<rwd::FlowKey> : fmt::formatter<std::string_view> {
+    template <typename FormatContext>
+    auto format(const rwd::FlowKey& key, FormatContext& ctx) const
+    {
+        return fmt::formatter<std::string_view>::format(key.toString(), ctx);
+    }
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace rwd {
+
+    // Open-addressing hash map for per-flow state, looked up on every packet
+    // or message. Linear probing over a compact array of 32-bit hash tags, so
+    // a lookup normally touches one cache line before the matching entry.
+    // Erasing shifts later entries back instead of leaving tombstones.
+    //
+    // Inserting or erasing may move entries: pointers returned by find() and
+    // tryEmplace() are only valid until the table is next modified.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class FlowTable {
+    public:
+        explicit FlowTable(size_t initialCapacity = 64)
+        {
+            size_t capacity = 16;
+            while (capacity < initialCapacity) {
+                capacity <<= 1;
+            }
+            tags_.assign(capacity, kEmpty);
+            entries_.resize(capacity);
+        }
+
+        Value* find(const Key& key)
+        {
+            size_t index = lookup(key, tagOf(key));
+            return index == kMissing ? nullptr : &entries_[index]->second;
+        }
+
+        const Value* find(const Key& key) const
+        {
+            size_t index = lookup(key, tagOf(key));
+            return index == kMissing ? nullptr : &entries_[index]->second;
+        }
+
+        // Constructs the value from args if key is absent. Returns the value
+        // and whether it was inserted.
+        template <typename... Args>
+        std::pair<Value*, bool> tryEmplace(const Key& key, Args&&... args)
+        {
+            uint32_t tag = tagOf(key);
+            size_t index = lookup(key, tag);
+            if (index != kMissing) {
+                return {&entries_[index]->second, false};
+            }
+
+            if ((size_ + 1) * 4 > tags_.size() * 3) {
+                rehash(tags_.size() * 2);
+            }
+
+            index = tag & mask();
+            while (tags_[index] != kEmpty) {
+                index = (index + 1) & mask();
+            }
+            tags_[index] = tag;
+            entries_[index].emplace(std::piecewise_construct,
+                std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+            size_++;
+            return {&entries_[index]->second, true};
+        }
+
+        Value& insertOrAssign(const Key& key, Value&& value)
+        {
+            auto [existing, inserted] = tryEmplace(key, std::move(value));
+            if (!inserted) {
+                *existing = std::move(value);
+            }
+            return *existing;
+        }
+
+        bool erase(const Key& key)
+        {
+            size_t hole = lookup(key, tagOf(key));
+            if (hole == kMissing) {
+                return false;
+            }
+
+            // Backward-shift: pull later members of the probe run into the
+            // hole as long as that does not move them before their home slot
+            size_t next = (hole + 1) & mask();
+            while (tags_[next] != kEmpty) {
+                size_t home = tags_[next] & mask();
+                if (((next - home) & mask()) >= ((next - hole) & mask())) {
+                    tags_[hole] = tags_[next];
+                    entries_[hole] = std::move(entries_[next]);
+                    hole = next;
+                }
+                next = (next + 1) & mask();
+            }
+
+            tags_[hole] = kEmpty;
+            entries_[hole].reset();
+            size_--;
+            return true;
+        }
+
+        void clear()
+        {
+            for (size_t i = 0; i < tags_.size(); i++) {
+                tags_[i] = kEmpty;
+                entries_[i].reset();
+            }
+            size_ = 0;
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        // Calls fn(key, value) for every entry, in no particular order. fn
+        // must not modify the table.
+        template <typename Fn>
+        void forEach(Fn&& fn)
+        {
+            for (size_t i = 0; i < tags_.size(); i++) {
+                if (tags_[i] != kEmpty) {
+                    fn(entries_[i]->first, entries_[i]->second);
+                }
+            }
+        }
+
+        template <typename Fn>
+        void forEach(Fn&& fn) const
+        {
+            for (size_t i = 0; i < tags_.size(); i++) {
+                if (tags_[i] != kEmpty) {
+                    fn(entries_[i]->first, entries_[i]->second);
+                }
+            }
+        }
+
+    private:
+        static constexpr uint32_t kEmpty = 0;
+        static constexpr size_t kMissing = static_cast<size_t>(-1);
+
+        static uint32_t tagOf(const Key& key)
+        {
+            size_t h = Hash{}(key);
+            uint32_t tag = static_cast<uint32_t>(h ^ (static_cast<uint64_t>(h) >> 32));
+            return tag == kEmpty ? 1 : tag;
+        }
+
+        size_t mask() const { return tags_.size() - 1; }
+
+        size_t lookup(const Key& key, uint32_t tag) const
+        {
+            size_t index = tag & mask();
+            while (tags_[index] != kEmpty) {
+                if (tags_[index] == tag && entries_[index]->first == key) {
+                    return index;
+                }
+                index = (index + 1) & mask();
+            }
+            return kMissing;
+        }
+
+        void rehash(size_t capacity)
+        {
+            std::vector<uint32_t> tags(capacity, kEmpty);
+            std::vector<std::optional<std::pair<Key, Value>>> entries(capacity);
+
+            for (size_t i = 0; i < tags_.size(); i++) {
+                if (tags_[i] == kEmpty) {
+                    continue;
+                }
+                size_t index = tags_[i] & (capacity - 1);
+                while (tags[index] != kEmpty) {
+                    index = (index + 1) & (capacity - 1);
+                }
+                tags[index] = tags_[i];
+                entries[index] = std::move(entries_[i]);
+            }
+
+            tags_.swap(tags);
+            entries_.swap(entries);
+        }
+
+        std::vector<uint32_t> tags_;
+        std::vector<std::optional<std::pair<Key, Value>>> entries_;
+        size_t size_ = 0;
+    };
+
+}
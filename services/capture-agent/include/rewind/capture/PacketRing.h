@@ -0,0 +1,65 @@
+#pragma once
+
+#include "rewind/config/Config.h"
+#include <RawPacket.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace rwd {
+
+    // Kernel-side packet counters (pcap_stats or PACKET_STATISTICS)
+    struct CaptureStats {
+        uint64_t packetsReceived = 0;
+        uint64_t packetsDropped = 0;
+        uint64_t packetsDroppedByInterface = 0;
+    };
+
+    // Linux AF_PACKET capture that reads whole blocks from a memory-mapped
+    // TPACKET_V3 ring. Packets are handed to the handler as RawPackets that
+    // point straight into the ring, so they are only valid during the call.
+    class PacketRing {
+    public:
+        using PacketHandler = std::function<void(pcpp::RawPacket*)>;
+
+        explicit PacketRing(const RingConfig& config);
+        ~PacketRing();
+
+        PacketRing(const PacketRing&) = delete;
+        PacketRing& operator=(const PacketRing&) = delete;
+
+        static bool isSupported();
+
+        bool open(const std::string& interfaceName);
+        bool setFilter(const std::string& bpfFilter);
+        // Join a PACKET_FANOUT_HASH group so the kernel spreads flows across
+        // every socket (possibly in other processes) using the same group id
+        bool joinFanout(uint16_t groupId);
+        bool start(PacketHandler handler);
+        void stop();
+        void close();
+
+        CaptureStats getStats() const;
+
+    private:
+        void run();
+        void processBlock(uint8_t* block);
+
+        RingConfig config_;
+        std::string interfaceName_;
+        int fd_;
+        uint8_t* ring_;
+        size_t ringSize_;
+
+        PacketHandler handler_;
+        std::thread thread_;
+        std::atomic<bool> running_;
+
+        // PACKET_STATISTICS resets on every read, so totals are kept here
+        mutable std::atomic<uint64_t> packetsReceived_;
+        mutable std::atomic<uint64_t> packetsDropped_;
+    };
+
+}
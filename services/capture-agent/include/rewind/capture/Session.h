@@ -1,29 +1,53 @@
 #pragma once
 
+#include "rewind/capture/FlowKey.h"
+#include "rewind/capture/SessionArena.h"
 #include "rewind/parsers/HttpMessage.h"
 #include <string>
 #include <vector>
+#include <deque>
 #include <chrono>
+#include <memory_resource>
+#include <optional>
 #include <nlohmann/json.hpp>
 
 namespace rwd {
 
     class HttpTransaction {
     public:
+        // Allocator-aware so a pmr container hands it its memory resource
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
         HttpTransaction()
-            : requestTime_(0.0)
+            : HttpTransaction(allocator_type())
+        {
+        }
+
+        explicit HttpTransaction(const allocator_type& allocator)
+            : request_(allocator.resource())
+            , response_(allocator.resource())
+            , requestTime_(0.0)
             , responseTime_(0.0)
             , duration_(0.0)
         {
         }
 
-        void setRequest(const HttpMessage& req, double timestamp) {
-            request_ = req;
+        HttpTransaction(HttpTransaction&& other, const allocator_type& allocator)
+            : HttpTransaction(allocator)
+        {
+            *this = std::move(other);
+        }
+
+        HttpTransaction(HttpTransaction&&) noexcept = default;
+        HttpTransaction& operator=(HttpTransaction&&) = default;
+
+        void setRequest(HttpMessage&& req, double timestamp) {
+            request_ = std::move(req);
             requestTime_ = timestamp;
         }
 
-        void setResponse(const HttpMessage& res, double timestamp) {
-            response_ = res;
+        void setResponse(HttpMessage&& res, double timestamp) {
+            response_ = std::move(res);
             responseTime_ = timestamp;
             duration_ = responseTime_ - requestTime_;
         }
@@ -38,7 +62,8 @@ namespace rwd {
         double getResponseTime() const { return responseTime_; }
         double getDuration() const { return duration_; }
 
-        nlohmann::json toJson() const;
+        nlohmann::json toJson(const BodyOptions& bodyOptions = BodyOptions()) const;
+        void writeJson(JsonWriter& writer, const BodyOptions& bodyOptions = BodyOptions()) const;
 
     private:
         HttpMessage request_;
@@ -48,40 +73,65 @@ namespace rwd {
         double duration_;       
     };
 
+    // Everything a session holds apart from message payloads is allocated
+    // from its own arena and released in one step when it is destroyed
     class Session {
     public:
-        Session(const std::string& sessionId,
-            const std::string& clientIp, int clientPort,
-            const std::string& serverIp, int serverPort);
+        explicit Session(const FlowKey& flow);
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
 
-        std::string getSessionId() const { return sessionId_; }
+        // "client:port->server:port@startMicros"; formatted on every call
+        std::string getSessionId() const;
+        const FlowKey& getFlowKey() const { return flow_; }
 
-        void addRequest(const HttpMessage& msg, double timestamp);
-        void addResponse(const HttpMessage& msg, double timestamp);
+        // Records which capture source owns each direction of this session;
+        // returns false if a different source already claimed it
+        bool claimSource(size_t sourceId, bool isRequest);
+        // True if either direction came from sourceId
+        bool isOwnedBy(size_t sourceId) const { return requestSource_ == sourceId || responseSource_ == sourceId; }
+        const std::optional<size_t>& getRequestSource() const { return requestSource_; }
+
+        void addRequest(HttpMessage&& msg, double timestamp);
+        void addResponse(HttpMessage&& msg, double timestamp);
 
         double getStartTime() const { return startTime_; }
         double getEndTime() const { return endTime_; }
         double getDuration() const { return endTime_ - startTime_; }
         size_t getTransactionCount() const { return transactions_.size(); }
+        const std::pmr::vector<HttpTransaction>& getTransactions() const { return transactions_; }
 
         void close();
         bool isClosed() const { return closed_; }
 
-        nlohmann::json toJson() const;
+        const SessionArena& getArena() const { return arena_; }
+
+        nlohmann::json toJson(const BodyOptions& bodyOptions = BodyOptions()) const;
+        // Same document as toJson(), appended to the writer's buffer without
+        // building it first; keys come in declaration order
+        void writeJson(JsonWriter& writer, const BodyOptions& bodyOptions = BodyOptions()) const;
 
     private:
-        std::string sessionId_;
-        std::string clientIp_;
-        int clientPort_;
-        std::string serverIp_;
-        int serverPort_;
+        // Extends the session's time span to cover a message of either kind
+        void touch(double timestamp);
+
+        // Declared first: destroyed after everything allocated from it
+        SessionArena arena_;
+
+        FlowKey flow_;
 
         double startTime_;
         double endTime_;
         bool closed_;
 
-        std::vector<HttpTransaction> transactions_;
-        HttpTransaction* currentTransaction_;
+        std::optional<size_t> requestSource_;
+        std::optional<size_t> responseSource_;
+
+        std::pmr::vector<HttpTransaction> transactions_;
+        // Indexes into transactions_ of requests still waiting for a response,
+        // oldest first (HTTP/1.1 responses arrive in request order)
+        std::pmr::deque<size_t> pendingRequests_;
     };
 
 }
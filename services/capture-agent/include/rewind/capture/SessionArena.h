@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace rwd {
+
+    // Bump allocator for what one session stores: its transaction list,
+    // pending request queue and the header indexes of its messages. Small
+    // allocations are carved out of chunks that start small, since most
+    // sessions hold a message or two, and double up to kChunkSize.
+    // Full-size chunks are recycled through a process-wide pool; everything
+    // goes back in one step when the session is destroyed. Large blocks (a grown transaction list) get their own
+    // allocation so they can be released as soon as they are replaced.
+    // Not thread-safe: a session is only touched by one thread at a time.
+    class SessionArena : public std::pmr::memory_resource {
+    public:
+        static constexpr size_t kFirstChunkSize = 1024;
+        static constexpr size_t kChunkSize = 16 * 1024;
+
+        SessionArena();
+        ~SessionArena() override;
+
+        SessionArena(const SessionArena&) = delete;
+        SessionArena& operator=(const SessionArena&) = delete;
+
+        // Bytes currently allocated, and bytes held from the pool and heap
+        size_t getUsedBytes() const { return used_; }
+        size_t getReservedBytes() const { return reserved_; }
+
+        // Reserved by all live arenas, now and at most so far
+        static size_t getTotalReservedBytes();
+        static size_t getPeakReservedBytes();
+
+    private:
+        struct Chunk {
+            char* data;
+            size_t size;
+        };
+
+        struct LargeBlock {
+            void* data;
+            size_t size;
+            size_t alignment;
+        };
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        void reserve(size_t bytes);
+
+        std::vector<Chunk> chunks_;
+        std::vector<LargeBlock> large_;
+        char* cursor_;
+        char* end_;
+        size_t nextChunkSize_;
+        size_t used_;
+        size_t reserved_;
+    };
+
+}
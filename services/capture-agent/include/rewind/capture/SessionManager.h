@@ -1,38 +1,95 @@
 #pragma once
 
+#include "rewind/capture/FlowTable.h"
 #include "rewind/capture/Session.h"
+#include "rewind/output/SessionSink.h"
 #include "rewind/parsers/HttpMessage.h"
-#include <map>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace rwd {
 
+    using SessionClosedCallback = std::function<void(const Session&)>;
+
+    // Tracks the sessions of connections that are still open. A session is
+    // closed when its connection ends (or is expired as idle by the capture
+    // worker); it is then handed to the sink and its memory released, so
+    // memory follows the number of concurrent connections rather than total
+    // traffic.
     class SessionManager {
     public:
         SessionManager();
         ~SessionManager();
 
-        void addMessage(const HttpMessage& msg,
-            const std::string& clientIp, int clientPort,
-            const std::string& serverIp, int serverPort,
-            bool isRequest);
+        // Where closed sessions go. Without a sink they are dropped.
+        void setSink(std::shared_ptr<SessionSink> sink) { sink_ = std::move(sink); }
+        // Called for every closed session (e.g. for metrics), from the thread
+        // that closed it
+        void setClosedCallback(SessionClosedCallback callback) { closedCallback_ = std::move(callback); }
 
-        std::vector<std::shared_ptr<Session>> getAllSessions() const;
+        // Takes the message into its session. Returns false if it was
+        // dropped as a duplicate of the same flow already being captured
+        // from another source (interface), or arrived late from another
+        // source after the flow's session was closed.
+        bool addMessage(HttpMessage&& msg,
+            const FlowKey& flow,
+            bool isRequest,
+            double timestamp,
+            size_t sourceId = 0);
 
-        void closeAllSessions();
+        // The connection carrying flow ended; timestamp is its last packet.
+        // Ignored unless sourceId is the source the session's messages came
+        // from.
+        void endSession(const FlowKey& flow, size_t sourceId = 0, double timestamp = 0.0);
 
-        size_t getSessionCount() const { return sessions_.size(); }
+        void closeAllSessions();
 
-        nlohmann::json toJson() const;
+        size_t getSessionCount() const;
+        size_t getClosedSessionCount() const { return closedSessions_.load(std::memory_order_relaxed); }
+        size_t getDuplicateMessageCount() const { return duplicateMessages_.load(std::memory_order_relaxed); }
 
     private:
-        std::string createSessionId(const std::string& clientIp, int clientPort,
-            const std::string& serverIp, int serverPort) const;
+        // A flow whose session was just written out. Another source's copy
+        // of the same connection may still be in flight and must not start
+        // a second, partial session.
+        struct ClosedFlow {
+            std::optional<size_t> requestSource;
+            double closedAt = 0.0;
+        };
+
+        // Capture workers add messages concurrently. Everything about a flow
+        // lives in the stripe its key hashes to, so workers handling
+        // different flows rarely wait on each other.
+        struct Stripe {
+            mutable std::mutex mutex;
+            FlowTable<FlowKey, std::shared_ptr<Session>, FlowKeyHash> sessions;
+            FlowTable<FlowKey, ClosedFlow, FlowKeyHash> recentlyClosed;
+            std::deque<std::pair<FlowKey, double>> closedOrder;  // Oldest first, for expiry
+        };
+
+        static constexpr size_t kStripeBits = 6;
+
+        Stripe& stripeFor(const FlowKey& flow);
+
+        // Writes out sessions already removed from their stripe; called
+        // without any lock held
+        void finalize(std::vector<std::shared_ptr<Session>>& closed);
+        static bool isLateCopyLocked(Stripe& stripe, const FlowKey& flow, bool isRequest, double timestamp, size_t sourceId);
+        static void forgetClosedLocked(Stripe& stripe, double now);
 
-        double getCurrentTimestamp() const;
+        std::array<Stripe, size_t(1) << kStripeBits> stripes_;
+        std::atomic<size_t> duplicateMessages_;
+        std::atomic<size_t> closedSessions_;
 
-        std::map<std::string, std::shared_ptr<Session>> sessions_;
+        std::shared_ptr<SessionSink> sink_;
+        SessionClosedCallback closedCallback_;
     };
 
 }
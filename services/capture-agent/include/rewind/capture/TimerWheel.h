@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace rwd {
+
+    // Hierarchical timing wheel on the packet clock: four levels of 64 slots,
+    // so the first level resolves single ticks and the last spans about
+    // 16.7M ticks (19 days at the default 100ms tick). Scheduling is O(1);
+    // timers move down a level at most three times before they fire, and
+    // stretches with nothing due are skipped a level slot at a time.
+    //
+    // Timers cannot be cancelled. Owners instead keep their real deadline
+    // next to their state, and when a timer fires either act on it or
+    // schedule again for the later deadline. Each flow then has at most one
+    // pending timer, however many packets it sees.
+    class TimerWheel {
+    public:
+        using ExpiryCallback = std::function<void(uint64_t id)>;
+
+        explicit TimerWheel(double tickSeconds = 0.1);
+
+        // Fires id once the wheel has been advanced to deadline (in seconds)
+        void schedule(uint64_t id, double deadline);
+
+        // Moves the wheel forward to now and calls onExpiry for every timer
+        // due by then. onExpiry may schedule new timers.
+        void advance(double now, const ExpiryCallback& onExpiry);
+
+        size_t size() const { return size_; }
+
+    private:
+        static constexpr size_t kLevels = 4;
+        static constexpr size_t kSlotBits = 6;
+        static constexpr size_t kSlots = size_t(1) << kSlotBits;
+
+        struct Timer {
+            uint64_t id;
+            uint64_t deadline;  // In ticks
+        };
+
+        uint64_t toTick(double seconds) const;
+        void place(const Timer& timer);
+        void cascade(size_t level);
+
+        double tickSeconds_;
+        uint64_t current_;   // Last tick processed
+        bool started_;
+        size_t size_;
+        std::array<std::array<std::vector<Timer>, kSlots>, kLevels> slots_;
+        std::array<size_t, kLevels> levelCounts_;
+        std::vector<Timer> firing_;
+    };
+
+}
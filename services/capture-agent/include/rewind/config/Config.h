@@ -3,9 +3,55 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <cstdint>
 
 namespace rwd {
 
+    // AF_PACKET TPACKET_V3 ring geometry (Linux only)
+    struct RingConfig {
+        size_t blockSize = 4 * 1024 * 1024;  // Must be a multiple of the page size
+        size_t blockCount = 64;
+        int retireTimeoutMs = 60;            // Hand over partially filled blocks after this long
+    };
+
+    // PACKET_FANOUT_HASH group shared by several agent processes (af_packet only)
+    struct FanoutConfig {
+        std::optional<uint16_t> groupId;
+        size_t memberIndex = 0;  // Distinguishes this process's output segment
+    };
+
+    // Seconds without a packet before a connection (and its session) is
+    // closed, by TCP state
+    struct IdleTimeoutConfig {
+        int handshakeSeconds = 10;     // Only SYN / SYN-ACK seen
+        int establishedSeconds = 300;
+        int halfClosedSeconds = 30;    // One side has sent FIN
+    };
+
+    // Recycling of message payload buffers
+    struct PayloadPoolConfig {
+        size_t maxBuffers = 1024;          // Idle buffers kept (high-water mark)
+        size_t maxBufferSize = 64 * 1024;  // Larger buffers are freed, not kept
+    };
+
+    // Batching and durability of the ndjson output format
+    struct NdjsonConfig {
+        size_t flushBytes = 64 * 1024;
+        int flushIntervalMs = 1000;
+        std::string fsync = "never";  // "never", "flush" or "interval"
+        int fsyncIntervalMs = 5000;
+    };
+
+    // Block size of the binary segment output format
+    struct SegmentConfig {
+        size_t blockBytes = 1024 * 1024;
+        int flushIntervalMs = 5000;
+        uint64_t rotateBytes = 256ull * 1024 * 1024;  // 0 = no size limit
+        int rotateIntervalSeconds = 300;              // 0 = no time limit
+        double maxAgeHours = 0;                       // 0 = keep segments
+        uint64_t maxTotalBytes = 0;                   // 0 = no limit
+    };
+
     struct CaptureConfig {
         std::optional<size_t> interfaceIndex;
         std::vector<size_t> interfaceIndexes;  // For multi-interface capture
@@ -13,12 +59,22 @@ namespace rwd {
         int timeoutSeconds = 60;
         std::string outputFile = "captured_sessions.json";
         std::string outputDirectory = "./output";
+        std::string outputFormat = "json";  // "json" (one document), "ndjson" (one session per line) or "segment" (binary)
+        NdjsonConfig ndjson;
+        SegmentConfig segment;
+        size_t workerThreads = 0;  // 0 = parse on the capture thread
+        std::string backend = "pcap";  // "pcap" or "af_packet"
+        RingConfig ring;
+        FanoutConfig fanout;
+        IdleTimeoutConfig idleTimeouts;
+        PayloadPoolConfig payloadPool;
     };
 
     struct FilterConfig {
         std::vector<int> ports;
         bool captureBody = true;
         size_t maxBodySize = 1048576; // 1MB
+        bool decompressBody = false;  // Decode gzip/deflate/br bodies on output
         std::string bpfFilter;
     };
 
@@ -62,6 +118,16 @@ namespace rwd {
         int getTimeoutSeconds() const { return capture_.timeoutSeconds; }
         std::string getOutputFile() const { return capture_.outputFile; }
         std::string getOutputDirectory() const { return capture_.outputDirectory; }
+        const std::string& getOutputFormat() const { return capture_.outputFormat; }
+        const NdjsonConfig& getNdjson() const { return capture_.ndjson; }
+        const SegmentConfig& getSegment() const { return capture_.segment; }
+        const IdleTimeoutConfig& getIdleTimeouts() const { return capture_.idleTimeouts; }
+        const PayloadPoolConfig& getPayloadPool() const { return capture_.payloadPool; }
+        size_t getWorkerThreads() const { return capture_.workerThreads; }
+        const std::string& getBackend() const { return capture_.backend; }
+        const RingConfig& getRing() const { return capture_.ring; }
+        const FanoutConfig& getFanout() const { return capture_.fanout; }
+        bool isFanoutEnabled() const { return capture_.fanout.groupId.has_value(); }
         std::string getBPFFilter() const;
         bool isSanitizationEnabled() const { return sanitization_.enabled; }
         bool isMetricsEnabled() const { return metrics_.enabled; }
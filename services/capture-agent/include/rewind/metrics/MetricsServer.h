@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <prometheus/exposer.h>
@@ -31,8 +32,15 @@ namespace rwd {
         void incrementErrors();
         void incrementDroppedPackets();
 
+        void setKernelPacketStats(uint64_t received, uint64_t dropped, uint64_t droppedByInterface);
+        void setPayloadPoolStats(uint64_t hits, uint64_t misses, uint64_t discarded, uint64_t pooled);
+
         void recordCaptureLatency(double seconds);
         void recordSessionDuration(double seconds);
+        // Arena bytes reserved by one session when it closed, and by all
+        // open sessions
+        void recordSessionArenaBytes(size_t bytes);
+        void setSessionArenaBytes(size_t bytes);
 
     private:
         int port_;
@@ -45,7 +53,12 @@ namespace rwd {
         prometheus::Family<prometheus::Counter>* sessionsFamily_;
         prometheus::Family<prometheus::Counter>* errorsFamily_;
         prometheus::Family<prometheus::Gauge>* gaugeFamily_;
+        prometheus::Family<prometheus::Counter>* kernelPacketsFamily_;
+        prometheus::Family<prometheus::Counter>* payloadPoolFamily_;
+        prometheus::Family<prometheus::Gauge>* payloadPoolIdleFamily_;
         prometheus::Family<prometheus::Histogram>* histogramFamily_;
+        prometheus::Family<prometheus::Gauge>* arenaFamily_;
+        prometheus::Family<prometheus::Histogram>* arenaHistogramFamily_;
 
         prometheus::Counter* packetsProcessed_;
         prometheus::Counter* httpMessages_;
@@ -56,7 +69,24 @@ namespace rwd {
         prometheus::Counter* errors_;
         prometheus::Counter* droppedPackets_;
         prometheus::Gauge* activeSessions_;
+        prometheus::Counter* kernelPacketsReceived_;
+        prometheus::Counter* kernelPacketsDropped_;
+        prometheus::Counter* kernelPacketsDroppedByInterface_;
+        prometheus::Counter* payloadPoolHits_;
+        prometheus::Counter* payloadPoolMisses_;
+        prometheus::Counter* payloadPoolDiscarded_;
+        prometheus::Gauge* payloadPoolIdle_;
         prometheus::Histogram* captureLatency_;
         prometheus::Histogram* sessionDuration_;
+        prometheus::Gauge* arenaReserved_;
+        prometheus::Histogram* sessionArena_;
+
+        // Totals at the last setKernelPacketStats / setPayloadPoolStats call
+        uint64_t lastKernelPacketsReceived_;
+        uint64_t lastKernelPacketsDropped_;
+        uint64_t lastKernelPacketsDroppedByInterface_;
+        uint64_t lastPayloadPoolHits_;
+        uint64_t lastPayloadPoolMisses_;
+        uint64_t lastPayloadPoolDiscarded_;
     };
 }
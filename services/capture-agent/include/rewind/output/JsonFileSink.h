@@ -0,0 +1,39 @@
+#pragma once
+
+#include "rewind/output/SessionSink.h"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace rwd {
+
+    // Writes sessions into one JSON document, {"sessions": [...],
+    // "sessionCount": N}, appending each as soon as it is closed. The closing
+    // bracket and count are rewritten after every session, so the file is a
+    // complete document whenever it is read.
+    class JsonFileSink : public SessionSink {
+    public:
+        JsonFileSink(const std::string& path, const BodyOptions& bodyOptions = BodyOptions());
+        ~JsonFileSink() override;
+
+        bool open();
+        bool write(const Session& session) override;
+        void close() override;
+
+        const std::string& getPath() const { return path_; }
+        size_t getSessionCount() const override;
+
+    private:
+        void writeTrailer();
+
+        std::string path_;
+        BodyOptions bodyOptions_;
+
+        mutable std::mutex mutex_;
+        std::ofstream out_;
+        std::streampos trailerPos_;
+        size_t sessionCount_;
+    };
+
+}
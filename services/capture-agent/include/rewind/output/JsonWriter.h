@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace rwd {
+
+    // Appends compact JSON straight to a caller-owned string, without
+    // building a document first. Commas are inserted automatically; the
+    // caller is responsible for balancing begin/end calls. Strings are
+    // escaped as nlohmann::json does, with invalid UTF-8 replaced by U+FFFD.
+    class JsonWriter {
+    public:
+        explicit JsonWriter(std::string& out)
+            : out_(out)
+            , depth_(0)
+            , hasElements_(0)
+            , afterKey_(false)
+        {
+        }
+
+        void beginObject() { open('{'); }
+        void endObject() { close('}'); }
+        void beginArray() { open('['); }
+        void endArray() { close(']'); }
+
+        void key(std::string_view name);
+
+        void value(std::string_view text);
+        void value(const char* text) { value(std::string_view(text)); }
+        void value(bool flag);
+        void value(double number);
+        void null();
+
+        template <typename T>
+            requires (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+        void value(T number)
+        {
+            separate();
+            if constexpr (std::is_signed_v<T>) {
+                writeInteger(static_cast<int64_t>(number));
+            } else {
+                writeInteger(static_cast<uint64_t>(number));
+            }
+        }
+
+        template <typename T>
+        void field(std::string_view name, T&& fieldValue)
+        {
+            key(name);
+            value(std::forward<T>(fieldValue));
+        }
+
+    private:
+        void open(char bracket);
+        void close(char bracket);
+        void separate();
+        void writeString(std::string_view text);
+        void writeInteger(int64_t number);
+        void writeInteger(uint64_t number);
+
+        std::string& out_;
+        // One bit per open container, set once it has an element. Nesting
+        // is limited to 63 levels; sessions use five.
+        uint32_t depth_;
+        uint64_t hasElements_;
+        bool afterKey_;
+    };
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "rewind/output/SessionSink.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+namespace rwd {
+
+    enum class FsyncPolicy {
+        Never,       // Leave it to the OS
+        EveryFlush,  // After every batch written
+        Interval     // At most once per fsyncInterval
+    };
+
+    struct NdjsonOptions {
+        size_t flushBytes = 64 * 1024;  // Write the batch once this much is buffered
+        double flushInterval = 1.0;     // ...or its oldest line is this many seconds old
+        FsyncPolicy fsync = FsyncPolicy::Never;
+        double fsyncInterval = 5.0;     // Seconds, for FsyncPolicy::Interval
+    };
+
+    // Appends one compact JSON object per closed session, one per line. Lines
+    // are batched in memory and written whole, so the file only ever grows
+    // by complete lines (except for a torn write if the agent dies mid-
+    // batch). Readers can remember the offset after the last newline they
+    // consumed and continue from there. An existing file is appended to.
+    class NdjsonFileSink : public SessionSink {
+    public:
+        NdjsonFileSink(const std::string& path,
+            const BodyOptions& bodyOptions = BodyOptions(),
+            const NdjsonOptions& options = NdjsonOptions());
+        ~NdjsonFileSink() override;
+
+        bool open();
+        bool write(const Session& session) override;
+        void poll() override;
+        void close() override;
+
+        const std::string& getPath() const { return path_; }
+        size_t getSessionCount() const override;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        bool flushLocked();
+        void syncLocked();
+
+        std::string path_;
+        BodyOptions bodyOptions_;
+        NdjsonOptions options_;
+
+        mutable std::mutex mutex_;
+        std::FILE* file_;
+        std::string batch_;
+        Clock::time_point batchStart_;
+        Clock::time_point lastSync_;
+        bool unsynced_;
+        size_t sessionCount_;
+    };
+
+}
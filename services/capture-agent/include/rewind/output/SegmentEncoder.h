@@ -0,0 +1,84 @@
+#pragma once
+
+#include "rewind/capture/Session.h"
+#include "rewind/output/SegmentFormat.h"
+#include <array>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rwd {
+
+    // Dictionary for one string column of a block. A value already seen is
+    // written as its index + 1; a new one as 0, its length and its bytes,
+    // after which it joins the dictionary.
+    class SegmentDictionary {
+    public:
+        void encode(std::string_view value, std::string& out);
+        void clear() { entries_.clear(); }
+
+    private:
+        struct Hash {
+            using is_transparent = void;
+            size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+        };
+
+        std::unordered_map<std::string, uint32_t, Hash, std::equal_to<>> entries_;
+    };
+
+    // A session with its headers and bodies rendered, so a sink can do the
+    // costly part of encoding before it takes its lock. Holds views into the
+    // session, which must outlive it.
+    struct SegmentSession {
+        struct Message {
+            const HttpMessage* message = nullptr;
+            std::vector<HttpMessage::HeaderPair> headers;
+            HttpMessage::BodyOutput body;
+        };
+
+        void render(const Session& source, const BodyOptions& options);
+
+        const Session* session = nullptr;
+        // Request, then response, of every transaction that has either
+        std::vector<Message> messages;
+        size_t messageCount = 0;
+    };
+
+    // Builds one block from sessions added in order
+    class SegmentBlockEncoder {
+    public:
+        SegmentBlockEncoder();
+
+        void add(const SegmentSession& rendered);
+
+        // Appends the finished block to out, fills in everything in info but
+        // the offset, and starts the next block
+        void finish(std::string& out, SegmentBlockInfo& info);
+
+        size_t getSessionCount() const { return sessionCount_; }
+        size_t getBufferedBytes() const;
+
+    private:
+        std::string& column(SegmentColumn id) { return columns_[static_cast<size_t>(id)]; }
+        void addMessage(const SegmentSession::Message& rendered);
+        void clear();
+
+        std::array<std::string, kSegmentColumnCount> columns_;
+        std::array<std::string, kSegmentColumnCount> deflated_;
+        SegmentDictionary methods_;
+        SegmentDictionary uris_;
+        SegmentDictionary statusMessages_;
+        SegmentDictionary versions_;
+        SegmentDictionary headerNames_;
+        SegmentDictionary headerValues_;
+        SegmentDictionary bodyTypes_;
+
+        uint32_t sessionCount_;
+        int64_t previousStart_;
+        int64_t firstStart_;
+        int64_t lastEnd_;
+    };
+
+}
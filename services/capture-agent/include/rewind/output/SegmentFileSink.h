@@ -0,0 +1,86 @@
+#pragma once
+
+#include "rewind/output/SegmentEncoder.h"
+#include "rewind/output/SegmentIndex.h"
+#include "rewind/output/SessionSink.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rwd {
+
+    struct SegmentOptions {
+        size_t blockBytes = 1024 * 1024;  // Write the block once its columns hold this much
+        double flushInterval = 5.0;       // ...or its oldest session is this many seconds old
+
+        uint64_t rotateBytes = 256ull * 1024 * 1024;  // Start a new segment past this size (0 = never)
+        int rotateInterval = 300;                     // ...or at each multiple of this many seconds of UTC (0 = never)
+
+        double maxAge = 0;           // Delete segments not written to for this many seconds (0 = keep)
+        uint64_t maxTotalBytes = 0;  // Delete the oldest segments while all of them exceed this (0 = no limit)
+    };
+
+    // Writes sessions into binary segments (see SegmentFormat.h); rewind-dump
+    // turns them back into JSON. Sessions are gathered into a block in memory
+    // and each block is written whole; the footer indexing them is written
+    // when the segment is finished.
+    //
+    // The path names a series rather than a file: output/captured_sessions.rwseg
+    // becomes output/captured_sessions.20261016T140000Z.rwseg and so on, each
+    // with a SegmentIndex sidecar. A new segment is started on the size and
+    // time limits and on every run, and old ones are deleted by the retention
+    // limits.
+    class SegmentFileSink : public SessionSink {
+    public:
+        SegmentFileSink(const std::string& path,
+            const BodyOptions& bodyOptions = BodyOptions(),
+            const SegmentOptions& options = SegmentOptions());
+        ~SegmentFileSink() override;
+
+        bool open();
+        bool write(const Session& session) override;
+        void poll() override;
+        void close() override;
+
+        // The segment being written
+        std::string getPath() const;
+        size_t getSessionCount() const override;
+        // Across all segments
+        uint64_t getBytesWritten() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        using WallClock = std::chrono::system_clock;
+
+        bool openSegmentLocked();
+        void finishSegmentLocked();
+        bool rotateLocked();
+        bool shouldRotateLocked(WallClock::time_point now) const;
+        void applyRetentionLocked();
+        bool flushLocked();
+        bool writeLocked(const std::string& bytes);
+
+        std::string directory_;
+        std::string stem_;
+        std::string extension_;
+        BodyOptions bodyOptions_;
+        SegmentOptions options_;
+
+        mutable std::mutex mutex_;
+        std::FILE* file_;
+        std::string path_;
+        std::string indexPath_;
+        SegmentIndex index_;
+        SegmentBlockEncoder encoder_;
+        std::string pending_;
+        Clock::time_point blockStart_;
+        WallClock::time_point rotateAt_;
+        Clock::time_point lastRetention_;
+        uint64_t offset_;
+        uint64_t bytesWritten_;
+        size_t sessionCount_;
+    };
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace rwd {
+
+    // Binary session segments (.rwseg). A segment is a file header, a run of
+    // self-contained blocks and a footer indexing them:
+    //
+    //   "RWSEG01\n"
+    //   block...   "RWBK", session count, column count, then the stored and
+    //              raw length of each column, then the columns back to back
+    //   footer     block count, then one SegmentBlockInfo per block
+    //   trailer    footer offset (u64), "RWSEGEND"
+    //
+    // Each column is its own byte stream, so a scan over one of them (e.g.
+    // transaction timings for latency analysis) reads nothing else. Times
+    // are whole microseconds held as varints, relative to the session start,
+    // which is relative to the previous session's. Strings are dictionary
+    // encoded per block; body text goes to the blob column. Where zlib is
+    // available a column is also deflated if that makes it smaller; its
+    // stored length is then less than its raw length. Fixed-width integers
+    // are little endian.
+    //
+    // A segment whose writer died has no footer; its complete blocks can
+    // still be found by walking them from the start.
+
+    constexpr std::string_view kSegmentMagic = "RWSEG01\n";
+    constexpr std::string_view kSegmentTrailerMagic = "RWSEGEND";
+    constexpr uint32_t kSegmentBlockMagic = 0x4B425752;  // "RWBK"
+    constexpr size_t kSegmentTrailerSize = 8 + kSegmentTrailerMagic.size();
+
+    enum class SegmentColumn : uint32_t {
+        Flows,             // Per session: IP version, addresses, ports
+        SessionTimes,      // Per session: start, length, transaction counts
+        TransactionTimes,  // Per transaction: presence, request/response time, duration
+        MessageHeads,      // Per message: type, status code, length
+        Methods,
+        Uris,
+        StatusMessages,
+        Versions,
+        HeaderNames,       // Per message: header count, then one name per header
+        HeaderValues,
+        Bodies,            // Per message: kind, flags, lengths
+        BodyTypes,
+        Blob,              // Body and preview text
+        Count
+    };
+
+    constexpr size_t kSegmentColumnCount = static_cast<size_t>(SegmentColumn::Count);
+
+    // TransactionTimes presence bits
+    constexpr uint8_t kSegmentHasRequest = 0x01;
+    constexpr uint8_t kSegmentHasResponse = 0x02;
+
+    // Bodies: the low two bits are the kind, as HttpMessage::BodyOutput::Kind
+    constexpr uint8_t kSegmentBodyKindMask = 0x03;
+    constexpr uint8_t kSegmentBodyNone = 0;
+    constexpr uint8_t kSegmentBodyText = 1;
+    constexpr uint8_t kSegmentBodyPreview = 2;
+    constexpr uint8_t kSegmentBodyType = 3;
+    constexpr uint8_t kSegmentBodyDecoded = 0x04;
+    constexpr uint8_t kSegmentBodyTruncated = 0x08;
+    constexpr uint8_t kSegmentBodyCaptureCut = 0x10;  // capturedBodyLength follows
+
+    // Footer entry
+    struct SegmentBlockInfo {
+        uint64_t offset = 0;
+        uint32_t length = 0;
+        uint32_t sessionCount = 0;
+        int64_t firstStart = 0;  // Earliest session start, microseconds
+        int64_t lastEnd = 0;     // Latest session end, microseconds
+    };
+
+    constexpr size_t kSegmentBlockInfoSize = 8 + 4 + 4 + 8 + 8;
+
+    // Block header entry per column
+    struct SegmentColumnLength {
+        uint32_t stored = 0;
+        uint32_t raw = 0;  // Larger than stored if the column is deflated
+    };
+
+    namespace segment {
+        void putVarint(std::string& out, uint64_t value);
+        void putSigned(std::string& out, int64_t value);
+        void putFixed32(std::string& out, uint32_t value);
+        void putFixed64(std::string& out, uint64_t value);
+
+        // Each consumes from the front of in; false if it runs out
+        bool getVarint(std::string_view& in, uint64_t& value);
+        bool getSigned(std::string_view& in, int64_t& value);
+        bool getFixed32(std::string_view& in, uint32_t& value);
+        bool getFixed64(std::string_view& in, uint64_t& value);
+
+        // Deflates raw into out; false if that is not possible (no zlib) or
+        // would not save anything
+        bool deflateColumn(std::string_view raw, std::string& out);
+        // False unless stored inflates to exactly rawLength bytes. A
+        // rawLength stored could never inflate to is rejected up front.
+        bool inflateColumn(std::string_view stored, size_t rawLength, std::string& out);
+
+        int64_t toMicros(double seconds);
+        inline double fromMicros(int64_t micros) { return static_cast<double>(micros) / 1e6; }
+    }
+
+}
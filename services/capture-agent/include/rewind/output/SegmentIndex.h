@@ -0,0 +1,35 @@
+#pragma once
+
+#include "rewind/output/SegmentFormat.h"
+#include <string>
+#include <vector>
+
+namespace rwd {
+
+    // Sidecar written next to each segment (<name>.rwidx) so that a time
+    // range can be matched to segments, and to blocks inside them, without
+    // opening the segments. It is small JSON and is rewritten after every
+    // block, so it also covers a segment whose writer died.
+    struct SegmentIndex {
+        std::string segment;     // File name of the segment, in the same directory
+        bool complete = false;   // The segment has its footer
+        uint64_t bytes = 0;
+        uint64_t sessionCount = 0;
+        int64_t firstStart = 0;  // Microseconds, as in SegmentBlockInfo
+        int64_t lastEnd = 0;
+        std::vector<SegmentBlockInfo> blocks;
+
+        void add(const SegmentBlockInfo& block);
+
+        // True if any session may overlap [from, to] (microseconds)
+        bool overlaps(int64_t from, int64_t to) const;
+    };
+
+    // captured_sessions.20261016T140000Z.rwseg -> captured_sessions.20261016T140000Z.rwidx
+    std::string segmentIndexPath(const std::string& segmentPath);
+
+    // Replaces the file atomically, so readers never see half an index
+    bool writeSegmentIndex(const std::string& path, const SegmentIndex& index);
+    bool readSegmentIndex(const std::string& path, SegmentIndex& index);
+
+}
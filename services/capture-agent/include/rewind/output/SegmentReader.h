@@ -0,0 +1,52 @@
+#pragma once
+
+#include "rewind/output/SegmentFormat.h"
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rwd {
+
+    // Reads the blocks of a segment written by SegmentFileSink, either whole
+    // (back to the JSON schema of Session::writeJson) or one column at a time
+    class SegmentReader {
+    public:
+        SegmentReader();
+
+        bool open(const std::string& path);
+
+        const std::vector<SegmentBlockInfo>& getBlocks() const { return blocks_; }
+        // False if the writer never finished the segment and its blocks were
+        // found by walking the file
+        bool hasFooter() const { return hasFooter_; }
+
+        // Reads one column of a block and nothing else
+        bool readColumn(size_t block, SegmentColumn column, std::string& out);
+
+        // Calls fn with each session of the block as a compact JSON object.
+        // With a range (microseconds), only sessions overlapping it.
+        bool readSessions(size_t block, const std::function<void(std::string_view)>& fn);
+        bool readSessions(size_t block, const std::function<void(std::string_view)>& fn,
+            int64_t from, int64_t to);
+
+        // Appends the durations of the block's complete transactions, in
+        // microseconds. Only the TransactionTimes column is read.
+        bool readDurations(size_t block, std::vector<int64_t>& durations);
+
+    private:
+        bool readAt(uint64_t offset, size_t length, std::string& out);
+        bool readFooter();
+        void walkBlocks();
+        bool readBlockLayout(uint64_t offset, uint32_t& sessionCount,
+            std::vector<SegmentColumnLength>& columnLengths, size_t& headerLength);
+
+        std::string path_;
+        std::ifstream in_;
+        uint64_t fileSize_;
+        std::vector<SegmentBlockInfo> blocks_;
+        bool hasFooter_;
+    };
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "rewind/capture/Session.h"
+
+namespace rwd {
+
+    // Destination for sessions once they are closed. write() may be called
+    // from several capture threads at once.
+    class SessionSink {
+    public:
+        virtual ~SessionSink() = default;
+
+        virtual bool write(const Session& session) = 0;
+
+        // Called periodically by the owner so time-based flushing happens
+        // even when no sessions are closing
+        virtual void poll() {}
+
+        // Completes the output; nothing is written after this
+        virtual void close() = 0;
+
+        // Sessions accepted so far
+        virtual size_t getSessionCount() const = 0;
+    };
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace rwd {
+
+    // Undoes Content-Encoding. Output is hard-capped so a small compressed
+    // body cannot expand without bound (zip bombs). gzip/deflate need zlib and
+    // br needs brotli at build time; without them those bodies stay encoded.
+    class ContentDecoder {
+    public:
+        enum class Encoding {
+            Identity,
+            Gzip,
+            Deflate,
+            Brotli,
+            Unsupported
+        };
+
+        // Parses a Content-Encoding value; only single codings are decoded
+        static Encoding parse(std::string_view contentEncoding);
+
+        static bool isAvailable(Encoding encoding);
+        static const char* name(Encoding encoding);
+
+        // Decodes input into output, stopping after maxOutput bytes (setting
+        // truncated). Returns false for corrupt input or an unavailable codec.
+        static bool decode(Encoding encoding, std::string_view input, size_t maxOutput,
+            std::string& output, bool& truncated);
+    };
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace rwd {
+
+    // Well-known header names, in canonical spelling
+#define REWIND_WELL_KNOWN_HEADERS(X) \
+    X(Accept, "Accept") \
+    X(AcceptCharset, "Accept-Charset") \
+    X(AcceptEncoding, "Accept-Encoding") \
+    X(AcceptLanguage, "Accept-Language") \
+    X(AcceptRanges, "Accept-Ranges") \
+    X(AccessControlAllowOrigin, "Access-Control-Allow-Origin") \
+    X(Age, "Age") \
+    X(Allow, "Allow") \
+    X(Authorization, "Authorization") \
+    X(CacheControl, "Cache-Control") \
+    X(Connection, "Connection") \
+    X(ContentDisposition, "Content-Disposition") \
+    X(ContentEncoding, "Content-Encoding") \
+    X(ContentLanguage, "Content-Language") \
+    X(ContentLength, "Content-Length") \
+    X(ContentLocation, "Content-Location") \
+    X(ContentRange, "Content-Range") \
+    X(ContentType, "Content-Type") \
+    X(Cookie, "Cookie") \
+    X(Date, "Date") \
+    X(ETag, "ETag") \
+    X(Expect, "Expect") \
+    X(Expires, "Expires") \
+    X(Forwarded, "Forwarded") \
+    X(From, "From") \
+    X(Host, "Host") \
+    X(IfMatch, "If-Match") \
+    X(IfModifiedSince, "If-Modified-Since") \
+    X(IfNoneMatch, "If-None-Match") \
+    X(IfRange, "If-Range") \
+    X(IfUnmodifiedSince, "If-Unmodified-Since") \
+    X(KeepAlive, "Keep-Alive") \
+    X(LastModified, "Last-Modified") \
+    X(Link, "Link") \
+    X(Location, "Location") \
+    X(MaxForwards, "Max-Forwards") \
+    X(Origin, "Origin") \
+    X(Pragma, "Pragma") \
+    X(ProxyAuthenticate, "Proxy-Authenticate") \
+    X(ProxyAuthorization, "Proxy-Authorization") \
+    X(Range, "Range") \
+    X(Referer, "Referer") \
+    X(RetryAfter, "Retry-After") \
+    X(Server, "Server") \
+    X(SetCookie, "Set-Cookie") \
+    X(StrictTransportSecurity, "Strict-Transport-Security") \
+    X(TE, "TE") \
+    X(Trailer, "Trailer") \
+    X(TransferEncoding, "Transfer-Encoding") \
+    X(Upgrade, "Upgrade") \
+    X(UserAgent, "User-Agent") \
+    X(Vary, "Vary") \
+    X(Via, "Via") \
+    X(WWWAuthenticate, "WWW-Authenticate") \
+    X(XForwardedFor, "X-Forwarded-For") \
+    X(XForwardedHost, "X-Forwarded-Host") \
+    X(XForwardedProto, "X-Forwarded-Proto") \
+    X(XRealIp, "X-Real-IP") \
+    X(XRequestId, "X-Request-Id") \
+    X(XRequestedWith, "X-Requested-With")
+
+    enum class HeaderName : uint16_t {
+#define REWIND_HEADER_ENUM(id, name) id,
+        REWIND_WELL_KNOWN_HEADERS(REWIND_HEADER_ENUM)
+#undef REWIND_HEADER_ENUM
+        Count
+    };
+
+    using HeaderId = uint16_t;
+
+    // Maps header names to small integer ids, case-insensitively. Well-known
+    // names resolve through a perfect hash computed at compile time; other
+    // names are interned in a process-wide table on first sight.
+    class HeaderNames {
+    public:
+        static constexpr HeaderId kNotInterned = UINT16_MAX;
+        // Bounds the table against traffic with random header names
+        static constexpr size_t kMaxInterned = 4096;
+
+        static constexpr HeaderId id(HeaderName name) { return static_cast<HeaderId>(name); }
+
+        // Well-known id of name, or kNotInterned
+        static HeaderId wellKnown(std::string_view name);
+
+        // Id of name if it is well-known or already interned, else kNotInterned
+        static HeaderId find(std::string_view name);
+
+        // Id of name, interning it if needed; kNotInterned once the table is full
+        static HeaderId intern(std::string_view name);
+
+        // Canonical (well-known) or first-seen (interned) spelling
+        static std::string_view name(HeaderId id);
+
+        static bool equalsIgnoreCase(std::string_view a, std::string_view b);
+    };
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "rewind/parsers/SimdLevel.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rwd {
+
+    // Offsets of one header line within a scanned block. lineEnd excludes the
+    // CR/LF; colon is kNoColon when the line has none.
+    struct HeaderLine {
+        static constexpr uint32_t kNoColon = UINT32_MAX;
+
+        uint32_t lineStart;
+        uint32_t colon;
+        uint32_t lineEnd;
+    };
+
+    // Single-pass scanner for HTTP header blocks. Finds line ends, the first
+    // colon of every line and the blank line that ends the block, 16 or 32
+    // bytes at a time where the CPU allows. The implementation is picked once
+    // at startup from the CPU's features.
+    class HeaderScanner {
+    public:
+        using Implementation = SimdLevel;
+
+        static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+        // Appends one entry per header line of data[0, length) to lines. Stops
+        // at the blank line and returns the offset just past it, or kNotFound
+        // if the block has no blank line (every complete line is indexed).
+        static size_t scan(const char* data, size_t length, std::vector<HeaderLine>& lines);
+
+        // Same, forcing a particular implementation (for benchmarks); falls
+        // back to scalar if the CPU does not support it
+        static size_t scan(const char* data, size_t length, std::vector<HeaderLine>& lines,
+            Implementation implementation);
+    };
+
+}
@@ -1,12 +1,35 @@
 #pragma once
 
+#include "rewind/parsers/HeaderNames.h"
+#include "rewind/parsers/HeaderScanner.h"
+#include "rewind/parsers/PayloadBuffer.h"
 #include <string>
-#include <map>
+#include <string_view>
+#include <memory>
+#include <memory_resource>
+#include <vector>
 #include <cstdint>
+#include <utility>
 #include <nlohmann/json.hpp>
 
 namespace rwd {
 
+    class JsonWriter;
+
+    // How message bodies are rendered when a session is written out
+    struct BodyOptions {
+        bool decompress = false;           // Undo gzip/deflate/br for text bodies
+        size_t maxDecodedSize = 1048576;   // Hard cap on decompressed output
+    };
+
+    // An HTTP/1.x message as a view over its raw bytes. The bytes live in a
+    // shared PayloadBuffer; fields are stored as offsets into it, so copying a
+    // message copies no payload. Headers are only split into name/value pairs
+    // the first time they are asked for, and owning strings are only created
+    // when the message is serialised. Header names are matched
+    // case-insensitively through their HeaderNames id.
+    // Messages are move-only: each one is handed from the parser to the
+    // transaction that stores it without being duplicated on the way.
     class HttpMessage {
     public:
         enum class Type {
@@ -16,44 +39,139 @@ namespace rwd {
         };
 
         HttpMessage();
+        // The header index is allocated from resource. Moving a message into
+        // one built on another resource copies its index across.
+        explicit HttpMessage(std::pmr::memory_resource* resource);
+        HttpMessage(HttpMessage&&) noexcept = default;
+        HttpMessage& operator=(HttpMessage&&) = default;
+        HttpMessage(const HttpMessage&) = delete;
+        HttpMessage& operator=(const HttpMessage&) = delete;
 
-        static HttpMessage parseFromData(const std::string& data, bool isClientToServer);
+        // Parses the start line of the complete header block held in the
+        // first headLength bytes of payload, including the blank line that
+        // terminates it. Body bytes are appended to the same payload.
+        static HttpMessage parseHead(std::shared_ptr<PayloadBuffer> payload, size_t headLength);
+
+        // True if the line begins like an HTTP/1.x request or status line
+        static bool isStartLine(std::string_view line);
 
         Type getType() const { return type_; }
-        std::string getMethod() const { return method_; }
-        std::string getUri() const { return uri_; }
-        std::string getVersion() const { return version_; }
+        std::string_view getMethod() const { return view(method_); }
+        std::string_view getUri() const { return view(uri_); }
+        std::string_view getVersion() const { return view(version_); }
         int getStatusCode() const { return statusCode_; }
-        std::string getStatusMessage() const { return statusMessage_; }
-        std::string getHeader(const std::string& name) const;
-        const std::map<std::string, std::string>& getHeaders() const { return headers_; }
-        std::string getBody() const { return body_; }
+        std::string_view getStatusMessage() const;
+        std::string_view getHeader(std::string_view name) const;
+        std::string_view getHeader(HeaderName name) const;
+        size_t getHeaderCount() const;
         size_t getLength() const { return length_; }
 
-        void setType(Type type) { type_ = type; }
-        void setMethod(const std::string& method) { method_ = method; }
-        void setUri(const std::string& uri) { uri_ = uri; }
-        void setVersion(const std::string& version) { version_ = version; }
-        void setStatusCode(int code) { statusCode_ = code; }
-        void setStatusMessage(const std::string& msg) { statusMessage_ = msg; }
-        void setHeader(const std::string& name, const std::string& value);
-        void setBody(const std::string& body) { body_ = body; }
+        // Body as it was on the wire, minus chunked framing, cut to the
+        // capture limit; getBodyLength() is the length before the cut
+        std::string_view getBody() const { return view(body_); }
+        size_t getBodyLength() const { return bodyLength_; }
+        bool isBodyTruncated() const { return bodyLength_ > body_.length; }
+
+        // Body with Content-Encoding undone, at most maxSize bytes. Decoding
+        // happens here, never while parsing. Returns false if the body is not
+        // encoded or cannot be decoded.
+        bool decodeBody(size_t maxSize, std::string& decoded, bool& truncated) const;
+
+        // Calls fn(name, value) for every header line, in wire order
+        template <typename Fn>
+        void forEachHeader(Fn&& fn) const
+        {
+            indexHeaders();
+            for (const auto& header : headers_) {
+                fn(view(Span{header.nameOffset, header.nameLength}), view(header.value));
+            }
+        }
+
+        // The body is always the tail of the payload
+        void appendBody(const char* data, size_t length);
+        // Counts body bytes that were not kept
+        void skipBody(size_t length) { bodyLength_ += length; }
         void setLength(size_t length) { length_ = length; }
 
         std::string getFirstLine() const;
         bool isValid() const { return type_ != Type::Unknown; }
-        nlohmann::json toJson() const;
+
+        // The message as a JSON object. writeJson streams the same fields
+        // without building a document; toJson is for callers that want one.
+        nlohmann::json toJson(const BodyOptions& options = BodyOptions()) const;
+        void writeJson(JsonWriter& writer, const BodyOptions& options = BodyOptions()) const;
+
+        using HeaderPair = std::pair<std::string_view, std::string_view>;
+
+        // What the serialised forms contain for the body, decided once for all
+        // of them. text may point into storage, so a filled-in BodyOutput is
+        // not to be copied or moved.
+        struct BodyOutput {
+            enum class Kind {
+                None,     // No body
+                Text,     // "body": text
+                Preview,  // "bodyPreview": text
+                Type      // "bodyType": text
+            };
+
+            Kind kind = Kind::None;
+            std::string_view text;
+            bool decoded = false;
+            bool truncated = false;
+            std::string storage;  // Decoded body or preview when text points here
+        };
+
+        // Appends the headers as output: non-empty and UTF-8, in wire order. A
+        // repeated name keeps its last value, at the position it last appeared.
+        void collectOutputHeaders(std::vector<HeaderPair>& headers) const;
+        void renderBody(const BodyOptions& options, BodyOutput& output) const;
 
     private:
+        struct Span {
+            uint32_t offset = 0;
+            uint32_t length = 0;
+        };
+
+        // 16 bytes per header; the wire spelling of the name is kept for output
+        struct HeaderField {
+            HeaderId nameId;
+            uint16_t nameLength;
+            uint32_t nameOffset;
+            Span value;
+        };
+
+        std::string_view view(Span span) const {
+            return payload_ ? payload_->view(span.offset, span.length) : std::string_view();
+        }
+        void parseStartLine(std::string_view line, size_t offset);
+        void indexHeaders() const;
+        void buildHeaderIndex(const std::vector<HeaderLine>& lines, size_t base) const;
+        std::string_view findHeader(HeaderId id) const;
+
+        // UTF-8 checks are cached; output can be rendered more than once
+        enum class Utf8State : uint8_t {
+            Unchecked,
+            Valid,
+            Invalid
+        };
+
+        bool isUtf8(Span span, Utf8State& state) const;
+
         Type type_;
-        std::string method_;
-        std::string uri_;
+        std::shared_ptr<PayloadBuffer> payload_;
+        Span method_;
+        Span uri_;
+        Span version_;
+        Span statusMessage_;
+        Span headerBlock_;
+        Span body_;
         int statusCode_;
-        std::string statusMessage_;
-        std::string version_;
-        std::map<std::string, std::string> headers_;
-        std::string body_;
         size_t length_;
+        size_t bodyLength_;
+        mutable std::pmr::vector<HeaderField> headers_;
+        mutable bool headersIndexed_;
+        mutable Utf8State headerBlockUtf8_;
+        mutable Utf8State bodyUtf8_;
     };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "rewind/parsers/HttpMessage.h"
+#include "rewind/parsers/PayloadBuffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace rwd {
+
+    // How much of each body is kept. Bytes past the limit are counted but
+    // never buffered.
+    struct BodyLimits {
+        bool captureBody = true;
+        size_t maxBodySize = 1048576;
+    };
+
+    // Incremental HTTP/1.x parser for one direction of one TCP connection.
+    // Bytes are fed as they are reassembled, in any segmentation; every byte
+    // is examined at most once. Header blocks are buffered until complete,
+    // bodies are framed by Content-Length or chunked encoding so body bytes
+    // are copied straight through without being scanned for a start line.
+    // Chunked bodies are de-chunked as they stream past; content encodings
+    // are left alone (see HttpMessage::decodeBody).
+    // Each message's bytes are copied once, into a pooled PayloadBuffer that
+    // the emitted HttpMessage keeps a reference to.
+    class HttpStreamParser {
+    public:
+        // Each completed message is moved out to the handler
+        using MessageHandler = std::function<void(HttpMessage&&)>;
+
+        explicit HttpStreamParser(const BodyLimits& limits = BodyLimits());
+
+        void setBodyLimits(const BodyLimits& limits);
+
+        // Consume newly reassembled bytes, calling onMessage for every message
+        // completed by them
+        void feed(const char* data, size_t length, const MessageHandler& onMessage);
+
+        // The stream skipped `length` bytes we never saw (capture loss). Body
+        // bytes can be accounted for; anything else forces a resync.
+        void skip(size_t length, const MessageHandler& onMessage);
+
+        // The connection closed; completes a response delimited by close
+        void finish(const MessageHandler& onMessage);
+
+        // Called on the response direction with the method of every request
+        // seen on the other direction, in order, so responses to HEAD (which
+        // carry a Content-Length but no body) and a 2xx to CONNECT (after
+        // which the tunnel starts) do not swallow what follows them.
+        // Only the most recent requests are remembered.
+        void expectResponse(std::string_view method);
+
+        void reset();
+
+        bool isIdle() const { return state_ == State::Head && !discarding_ && (!payload_ || payload_->empty()); }
+
+    private:
+        enum class State {
+            Head,          // Buffering start line + headers
+            Body,          // Content-Length body, bodyRemaining_ bytes left
+            ChunkSize,     // Reading a chunk-size line
+            ChunkData,     // Inside a chunk, bodyRemaining_ bytes left
+            ChunkDataEnd,  // CRLF after chunk data
+            Trailers,      // Trailer section after the last chunk
+            UntilClose     // Response body delimited by connection close
+        };
+
+        size_t consumeHead(const char* data, size_t length, const MessageHandler& onMessage);
+        size_t consumeLine(const char* data, size_t length, bool& complete);
+        void beginBody(const MessageHandler& onMessage);
+        void complete(const MessageHandler& onMessage);
+        void appendBody(const char* data, size_t length);
+
+        State state_;
+        std::shared_ptr<PayloadBuffer> payload_;
+        size_t headLines_;
+        bool discarding_;  // Dropping the rest of a line that cannot start a message
+        std::string line_;
+        HttpMessage message_;
+        size_t bodyRemaining_;
+        size_t bodyLimit_;   // Body bytes kept per message
+        size_t messageLength_;
+        // What the request each pending response answers implies for its body
+        enum class Expected : uint8_t {
+            Normal,
+            Bodiless,  // HEAD
+            Tunnel     // CONNECT: bodiless if 2xx
+        };
+        std::deque<Expected> pendingResponses_;
+    };
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace rwd {
+
+    // Growable byte buffer holding the raw bytes of one HTTP message. Buffers
+    // are reference-counted so message views can share them, and recycled
+    // through a process-wide pool so their capacity is reused. A buffer goes
+    // back to the pool when its last message is released, i.e. once the
+    // session holding it has been written out.
+    class PayloadBuffer {
+    public:
+        struct PoolStats {
+            size_t hits = 0;       // Acquired from the pool
+            size_t misses = 0;     // Newly allocated
+            size_t discarded = 0;  // Freed on release: pool full or buffer too large
+            size_t pooled = 0;     // Idle in the pool now
+        };
+
+        static std::shared_ptr<PayloadBuffer> acquire();
+
+        // maxBuffers is the pool's high-water mark: idle buffers beyond it are
+        // freed. Buffers that grew past maxCapacity are never kept.
+        static void configurePool(size_t maxBuffers, size_t maxCapacity);
+        static PoolStats getPoolStats();
+
+        const char* data() const { return bytes_.data(); }
+        size_t size() const { return bytes_.size(); }
+        bool empty() const { return bytes_.empty(); }
+
+        void append(const char* data, size_t length) { bytes_.append(data, length); }
+        void clear() { bytes_.clear(); }
+
+        std::string_view view() const { return std::string_view(bytes_); }
+        std::string_view view(size_t offset, size_t length) const {
+            return std::string_view(bytes_).substr(offset, length);
+        }
+
+    private:
+        PayloadBuffer() = default;
+        static void release(PayloadBuffer* buffer);
+
+        std::string bytes_;
+    };
+
+}
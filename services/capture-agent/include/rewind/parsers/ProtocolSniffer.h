@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace rwd {
+
+    // Classifies the start of a chunk of TCP payload by looking at no more
+    // than kPrefixLength bytes, so non-HTTP and body-only data is rejected
+    // without being scanned.
+    class ProtocolSniffer {
+    public:
+        enum class Result {
+            RequestStart,   // "<method> " with a known method
+            ResponseStart,  // "HTTP/"
+            Continuation,   // Text that is not a start line (mid-message)
+            NotHttp,        // TLS records
+            Binary,         // Control bytes: a binary protocol, or a binary body
+            Incomplete      // Too few bytes to tell
+        };
+
+        // Longest method (UPDATEREDIRECTREF) plus the space
+        static constexpr size_t kPrefixLength = 18;
+
+        static Result sniff(const char* data, size_t length);
+        static Result sniff(std::string_view data) { return sniff(data.data(), data.length()); }
+
+        static bool isStart(Result result) {
+            return result == Result::RequestStart || result == Result::ResponseStart;
+        }
+
+        // True if token is one of the RFC 9110, RFC 5789 or WebDAV methods
+        static bool isKnownMethod(std::string_view token);
+    };
+
+}
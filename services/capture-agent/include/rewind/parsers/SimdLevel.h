@@ -0,0 +1,22 @@
+#pragma once
+
+namespace rwd {
+
+    // Instruction set tiers the vectorised parsers are built for. Each is
+    // compiled with a function-level target attribute and picked at runtime.
+    enum class SimdLevel {
+        Scalar,
+        Sse42,
+        Avx2
+    };
+
+    // Best level this CPU supports (computed once)
+    SimdLevel detectSimdLevel();
+    bool isSimdLevelSupported(SimdLevel level);
+    const char* simdLevelName(SimdLevel level);
+
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define REWIND_X86_SIMD 1
+#endif
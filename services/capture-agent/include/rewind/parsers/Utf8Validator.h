@@ -0,0 +1,23 @@
+#pragma once
+
+#include "rewind/parsers/SimdLevel.h"
+#include <string_view>
+
+namespace rwd {
+
+    // Strict UTF-8 validation (RFC 3629: no overlong forms, surrogates or
+    // code points past U+10FFFF), which is what the JSON writer requires.
+    // Runs of ASCII are skipped 32 or 64 bytes at a time where the CPU
+    // allows; multi-byte sequences are checked one at a time.
+    class Utf8Validator {
+    public:
+        using Implementation = SimdLevel;
+
+        static bool validate(std::string_view data);
+
+        // Same, forcing a particular implementation (for benchmarks); falls
+        // back to scalar if the CPU does not support it
+        static bool validate(std::string_view data, Implementation implementation);
+    };
+
+}
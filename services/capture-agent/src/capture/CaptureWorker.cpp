@@ -0,0 +1,530 @@
+#include "rewind/capture/CaptureWorker.h"
+#include "rewind/parsers/ProtocolSniffer.h"
+#include "Packet.h"
+#include "TcpLayer.h"
+#include "PacketUtils.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace rwd {
+
+    namespace {
+        // Seconds the reassembly keeps a closed flow, ignoring its packets,
+        // before purgeClosedConnections() may drop it. 0 would mean its
+        // default of 5, so this is the shortest it allows.
+        constexpr uint32_t kClosedConnectionDelay = 1;
+    }
+
+    CaptureWorker::CaptureWorker(size_t id, HttpMessageCallback callback, const BodyLimits& bodyLimits,
+        const FlowTimeouts& timeouts, size_t maxQueueDepth)
+        : id_(id)
+        , httpCallback_(std::move(callback))
+        , bodyLimits_(bodyLimits)
+        , timeouts_(timeouts)
+        , packetTime_(0.0)
+        , timerTokens_(0)
+        , pendingPurge_(0)
+        , offline_(false)
+        , maxQueueDepth_(maxQueueDepth)
+        , tickTime_(0.0)
+        , running_(false)
+        , httpMessageCount_(0)
+        , droppedPacketCount_(0)
+        , expiredFlowCount_(0)
+    {
+        tcpReassembly_ = std::make_unique<pcpp::TcpReassembly>(
+            onTcpMessageReadyStatic,
+            this,
+            onTcpConnectionStartStatic,
+            onTcpConnectionEndStatic,
+            pcpp::TcpReassemblyConfiguration(true, kClosedConnectionDelay)
+        );
+    }
+
+    CaptureWorker::~CaptureWorker()
+    {
+        stop();
+    }
+
+    void CaptureWorker::start()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (running_) {
+                return;
+            }
+            running_ = true;
+        }
+
+        thread_ = std::thread(&CaptureWorker::run, this);
+        spdlog::debug("Capture worker {} started", id_);
+    }
+
+    void CaptureWorker::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (!running_) {
+                // Inline mode (or already stopped): nothing else will touch
+                // the connections, so end them here
+                if (!thread_.joinable()) {
+                    closeAllConnections();
+                }
+                return;
+            }
+            running_ = false;
+        }
+
+        queueCv_.notify_one();
+        queueSpaceCv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        spdlog::debug("Capture worker {} stopped", id_);
+    }
+
+    void CaptureWorker::processPacket(pcpp::RawPacket* rawPacket)
+    {
+        pcpp::Packet packet(rawPacket);
+
+        if (!packet.isPacketOfType(pcpp::TCP)) {
+            return;
+        }
+
+        timespec ts = rawPacket->getPacketTimeStamp();
+        packetTime_ = static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+        runTimers();
+
+        pcpp::TcpReassembly::ReassemblyStatus status = tcpReassembly_->reassemblePacket(packet);
+        if (status == pcpp::TcpReassembly::Ignore_PacketOfClosedFlow && offline_) {
+            reopenClosedFlow(packet);
+        }
+        trackActivity(packet, packetTime_);
+    }
+
+    void CaptureWorker::reopenClosedFlow(pcpp::Packet& packet)
+    {
+        // Only a flow that expired idle, or a new SYN on a 5-tuple whose
+        // connection ended, is meant to carry on; stray packets after a
+        // FIN/RST stay ignored
+        uint32_t flowKey = pcpp::hash5Tuple(&packet);
+        pcpp::TcpLayer* tcpLayer = packet.getLayerOfType<pcpp::TcpLayer>();
+        bool newConnection = tcpLayer && tcpLayer->getTcpHeader()->synFlag && !tcpLayer->getTcpHeader()->ackFlag;
+        if (!newConnection && !expiredKeys_.find(flowKey)) {
+            return;
+        }
+
+        // The reassembly can only forget the closed key in its purge, which
+        // goes by the wall clock. A live capture is past that by the time a
+        // flow resumes; a replay runs ahead of it, so wait for the purge
+        // rather than lose the flow.
+        pcpp::ConnectionData connection;
+        connection.flowKey = flowKey;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kClosedConnectionDelay + 1);
+        while (tcpReassembly_->isConnectionOpen(connection) == 0) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                spdlog::warn("Dropping packet of closed flow {:#x} (worker {})", flowKey, id_);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            size_t purged = tcpReassembly_->purgeClosedConnections();
+            pendingPurge_ -= std::min(pendingPurge_, purged);
+        }
+
+        expiredKeys_.erase(flowKey);
+        tcpReassembly_->reassemblePacket(packet);
+    }
+
+    void CaptureWorker::runTimers()
+    {
+        // Timers run on packet time, so a replayed file expires flows exactly
+        // as the live capture would have
+        timers_.advance(packetTime_, [this](uint64_t id) {
+            onTimer(static_cast<uint32_t>(id), static_cast<uint32_t>(id >> 32));
+        });
+
+        // A closed flow key stays in the reassembly, and its packets are
+        // ignored, until it is purged on the wall clock (see reopenClosedFlow)
+        if (pendingPurge_ > 0) {
+            size_t purged = tcpReassembly_->purgeClosedConnections();
+            pendingPurge_ -= std::min(pendingPurge_, purged);
+        }
+
+        // Forget expired keys once the reassembly has let go of them too
+        pcpp::ConnectionData connection;
+        while (!expiredOrder_.empty()) {
+            connection.flowKey = expiredOrder_.front();
+            if (tcpReassembly_->isConnectionOpen(connection) == 0) {
+                break;
+            }
+            expiredKeys_.erase(connection.flowKey);
+            expiredOrder_.pop_front();
+        }
+    }
+
+    void CaptureWorker::trackActivity(pcpp::Packet& packet, double timestamp)
+    {
+        // Same key the reassembly uses for the connection
+        uint32_t flowKey = pcpp::hash5Tuple(&packet);
+        ConnectionInfo* conn = connectionMap_.find(flowKey);
+        if (!conn) {
+            return;
+        }
+
+        conn->lastTimestamp = timestamp;
+
+        pcpp::TcpLayer* tcpLayer = packet.getLayerOfType<pcpp::TcpLayer>();
+        if (tcpLayer) {
+            const pcpp::tcphdr* header = tcpLayer->getTcpHeader();
+            if (header->synFlag) {
+                conn->synSeen = true;
+            }
+            else {
+                conn->established = true;
+            }
+            if (header->finFlag && !conn->finSeen) {
+                // Half-closed flows time out sooner than the pending timer
+                conn->finSeen = true;
+                conn->timerToken = 0;
+            }
+        }
+
+        if (conn->timerToken == 0) {
+            armTimer(flowKey, *conn, timestamp + idleTimeout(*conn));
+        }
+    }
+
+    double CaptureWorker::idleTimeout(const ConnectionInfo& conn) const
+    {
+        if (conn.finSeen) {
+            return timeouts_.halfClosed;
+        }
+        return conn.established ? timeouts_.established : timeouts_.handshake;
+    }
+
+    void CaptureWorker::armTimer(uint32_t flowKey, ConnectionInfo& conn, double deadline)
+    {
+        // A new token makes any earlier timer for this flow key stale
+        if (++timerTokens_ == 0) {
+            timerTokens_ = 1;
+        }
+        conn.timerToken = timerTokens_;
+        timers_.schedule((static_cast<uint64_t>(conn.timerToken) << 32) | flowKey, deadline);
+    }
+
+    void CaptureWorker::onTimer(uint32_t flowKey, uint32_t token)
+    {
+        ConnectionInfo* conn = connectionMap_.find(flowKey);
+        if (!conn || conn->timerToken != token) {
+            return;  // Superseded, or the connection has ended
+        }
+
+        // Timers are not moved when packets arrive; if the flow has been
+        // active since, wait for the new deadline instead
+        double deadline = conn->lastTimestamp + idleTimeout(*conn);
+        if (deadline > packetTime_) {
+            armTimer(flowKey, *conn, deadline);
+            return;
+        }
+
+        spdlog::debug("Closing idle flow {} after {:.0f}s (worker {})",
+            conn->flow, packetTime_ - conn->lastTimestamp, id_);
+        expiredFlowCount_.fetch_add(1, std::memory_order_relaxed);
+        if (offline_ && expiredKeys_.tryEmplace(flowKey, true).second) {
+            expiredOrder_.push_back(flowKey);
+        }
+
+        // Ends up in endConnection through the reassembly's callback, unless
+        // the reassembly has already closed or forgotten the flow
+        tcpReassembly_->closeConnection(flowKey);
+        if (connectionMap_.find(flowKey)) {
+            endConnection(flowKey);
+        }
+    }
+
+    bool CaptureWorker::enqueue(const pcpp::RawPacket& rawPacket, bool block)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            if (block) {
+                queueSpaceCv_.wait(lock, [this] { return queue_.size() < maxQueueDepth_ || !running_; });
+            }
+            if (queue_.size() >= maxQueueDepth_) {
+                droppedPacketCount_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            queue_.emplace_back(rawPacket);
+        }
+
+        queueCv_.notify_one();
+        return true;
+    }
+
+    void CaptureWorker::tick(double packetTime)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (!running_) {
+                return;
+            }
+            tickTime_ = std::max(tickTime_, packetTime);
+        }
+
+        queueCv_.notify_one();
+    }
+
+    void CaptureWorker::run()
+    {
+        std::deque<pcpp::RawPacket> batch;
+
+        while (true) {
+            double tickTime;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex_);
+                queueCv_.wait(lock, [this] { return !queue_.empty() || tickTime_ > 0.0 || !running_; });
+
+                if (queue_.empty() && !running_) {
+                    break;
+                }
+
+                // Take the whole backlog at once so the capture thread only
+                // contends for the lock once per batch
+                batch.swap(queue_);
+                tickTime = tickTime_;
+                tickTime_ = 0.0;
+            }
+            queueSpaceCv_.notify_all();
+
+            for (auto& rawPacket : batch) {
+                processPacket(&rawPacket);
+            }
+            batch.clear();
+
+            // The tick was sent after every packet already queued here, so
+            // it never moves the clock backwards past one of them
+            if (tickTime > packetTime_) {
+                packetTime_ = tickTime;
+                runTimers();
+            }
+        }
+
+        closeAllConnections();
+    }
+
+    void CaptureWorker::closeAllConnections()
+    {
+        if (connectionMap_.empty()) {
+            return;
+        }
+
+        // Ends up in endConnection through the reassembly's callback
+        tcpReassembly_->closeAllConnections();
+
+        // Connections the reassembly had already forgotten
+        std::vector<uint32_t> remaining;
+        connectionMap_.forEach([&remaining](uint32_t flowKey, const ConnectionInfo&) {
+            remaining.push_back(flowKey);
+        });
+        for (uint32_t flowKey : remaining) {
+            endConnection(flowKey);
+        }
+    }
+
+    void CaptureWorker::onTcpMessageReadyStatic(
+        int8_t side,
+        const pcpp::TcpStreamData& tcpData,
+        void* userCookie)
+    {
+        auto* worker = static_cast<CaptureWorker*>(userCookie);
+        worker->onTcpMessageReady(side, tcpData);
+    }
+
+    CaptureWorker::ConnectionInfo& CaptureWorker::addConnection(
+        uint32_t flowKey,
+        const pcpp::ConnectionData& connData,
+        bool srcIsClient)
+    {
+        ConnectionInfo& info = connectionMap_.insertOrAssign(flowKey, ConnectionInfo());
+        info.lastTimestamp = packetTime_;
+        info.parsers[0].setBodyLimits(bodyLimits_);
+        info.parsers[1].setBodyLimits(bodyLimits_);
+
+        const pcpp::IPAddress& clientIp = srcIsClient ? connData.srcIP : connData.dstIP;
+        const pcpp::IPAddress& serverIp = srcIsClient ? connData.dstIP : connData.srcIP;
+
+        FlowKey& flow = info.flow;
+        flow.clientPort = srcIsClient ? connData.srcPort : connData.dstPort;
+        flow.serverPort = srcIsClient ? connData.dstPort : connData.srcPort;
+        if (clientIp.isIPv4()) {
+            flow.ipVersion = 4;
+            std::memcpy(flow.clientAddress.data(), clientIp.getIPv4().toBytes(), 4);
+            std::memcpy(flow.serverAddress.data(), serverIp.getIPv4().toBytes(), 4);
+        }
+        else {
+            flow.ipVersion = 6;
+            std::memcpy(flow.clientAddress.data(), clientIp.getIPv6().toBytes(), 16);
+            std::memcpy(flow.serverAddress.data(), serverIp.getIPv6().toBytes(), 16);
+        }
+
+        return info;
+    }
+
+    void CaptureWorker::onTcpMessageReady(int8_t side, const pcpp::TcpStreamData& tcpData) {
+        const pcpp::ConnectionData& connData = tcpData.getConnectionData();
+        uint32_t flowKey = connData.flowKey;
+
+        ConnectionInfo* found = connectionMap_.find(flowKey);
+        if (!found) {
+            bool isClientToServer = (side == 0);
+            found = &addConnection(flowKey, connData, isClientToServer);
+        }
+
+        ConnectionInfo& conn = *found;
+        conn.lastTimestamp = std::chrono::duration<double>(
+            tcpData.getTimeStamp().time_since_epoch()).count();
+
+        if (conn.nonHttp) {
+            return;
+        }
+
+        const char* data = reinterpret_cast<const char*>(tcpData.getData());
+        size_t length = tcpData.getDataLength();
+
+        if (!conn.sniffed) {
+            // The first bytes of a flow decide whether it is worth parsing
+            // at all (TLS, database protocols sharing port 80, ...)
+            ProtocolSniffer::Result kind = ProtocolSniffer::sniff(data, length);
+            if (kind == ProtocolSniffer::Result::NotHttp) {
+                markNonHttp(conn, "payload is TLS");
+                return;
+            }
+
+            // Joined mid-stream, binary bytes may just be the middle of a
+            // body; keep sniffing until a start line and let the parser
+            // resynchronise meanwhile
+            if (conn.synSeen) {
+                if (kind == ProtocolSniffer::Result::Binary) {
+                    markNonHttp(conn, "payload is binary");
+                    return;
+                }
+                conn.sniffed = (kind != ProtocolSniffer::Result::Incomplete);
+            }
+            else {
+                conn.sniffed = ProtocolSniffer::isStart(kind);
+            }
+        }
+
+        int index = (side == 0) ? 0 : 1;
+        HttpStreamParser& parser = conn.parsers[index];
+        HttpStreamParser& peer = conn.parsers[1 - index];
+
+        auto onMessage = [this, &conn, &peer](HttpMessage&& msg) {
+            HttpMessage::Type type = msg.getType();
+            int status = msg.getStatusCode();
+            if (type == HttpMessage::Type::Request) {
+                peer.expectResponse(msg.getMethod());
+                if (msg.getMethod() == "CONNECT") {
+                    conn.tunnelRequested = true;
+                }
+            }
+            emitMessage(conn, std::move(msg));
+
+            // Past a protocol switch or an established tunnel the bytes are
+            // no longer HTTP/1.x
+            if (type == HttpMessage::Type::Response) {
+                if (status == 101) {
+                    markNonHttp(conn, "switched protocols");
+                }
+                else if (conn.tunnelRequested && status >= 200 && status < 300) {
+                    markNonHttp(conn, "CONNECT tunnel established");
+                }
+            }
+        };
+
+        if (tcpData.isBytesMissing()) {
+            parser.skip(tcpData.getMissingByteCount(), onMessage);
+        }
+
+        parser.feed(data, length, onMessage);
+    }
+
+    void CaptureWorker::emitMessage(const ConnectionInfo& conn, HttpMessage&& msg)
+    {
+        httpMessageCount_.fetch_add(1, std::memory_order_relaxed);
+
+        bool isRequest = (msg.getType() == HttpMessage::Type::Request);
+
+        if (httpCallback_) {
+            httpCallback_(std::move(msg), conn.flow, isRequest, conn.lastTimestamp);
+        }
+    }
+
+    void CaptureWorker::markNonHttp(ConnectionInfo& conn, const char* reason)
+    {
+        if (conn.nonHttp) {
+            return;
+        }
+
+        conn.nonHttp = true;
+        spdlog::debug("Ignoring flow {}: {} (worker {})", conn.flow, reason, id_);
+    }
+
+    void CaptureWorker::onTcpConnectionStartStatic(
+        const pcpp::ConnectionData& connectionData,
+        void* userCookie)
+    {
+        auto* worker = static_cast<CaptureWorker*>(userCookie);
+
+        uint32_t flowKey = connectionData.flowKey;
+
+        ConnectionInfo& info = worker->addConnection(flowKey, connectionData, true);
+
+        spdlog::debug("TCP connection started: {} (worker {})", info.flow, worker->id_);
+    }
+
+    void CaptureWorker::onTcpConnectionEndStatic(
+        const pcpp::ConnectionData& connectionData,
+        pcpp::TcpReassembly::ConnectionEndReason reason,
+        void* userCookie)
+    {
+        auto* worker = static_cast<CaptureWorker*>(userCookie);
+        // The reassembly queues the flow key for purging as it reports the
+        // close, once per flow
+        worker->pendingPurge_++;
+        worker->endConnection(connectionData.flowKey);
+    }
+
+    void CaptureWorker::endConnection(uint32_t flowKey)
+    {
+        ConnectionInfo* found = connectionMap_.find(flowKey);
+        if (found) {
+            // Flush responses delimited by connection close
+            ConnectionInfo& conn = *found;
+            if (!conn.nonHttp) {
+                auto onMessage = [this, &conn](HttpMessage&& msg) {
+                    emitMessage(conn, std::move(msg));
+                };
+                conn.parsers[0].finish(onMessage);
+                conn.parsers[1].finish(onMessage);
+            }
+
+            // Copied out: the callback must not see the entry being erased.
+            // Any pending timer is left to find the entry gone.
+            FlowKey flow = conn.flow;
+            double lastTimestamp = conn.lastTimestamp;
+            connectionMap_.erase(flowKey);
+
+            if (flowEndCallback_) {
+                flowEndCallback_(flow, lastTimestamp);
+            }
+        }
+
+        spdlog::debug("TCP connection ended: flowKey={} (worker {})", flowKey, id_);
+    }
+
+}
@@ -1,19 +1,31 @@
 #include "rewind/capture/Capturer.h"
 #include "PcapLiveDeviceList.h"
 #include "PcapLiveDevice.h"
-#include "TcpReassembly.h"
 #include "Packet.h"
 #include "TcpLayer.h"
-#include "IPv4Layer.h"
+#include "PacketUtils.h"
+#include "PcapFilter.h"
+#include "PcapFileDevice.h"
 #include <spdlog/spdlog.h>
+#include <chrono>
 
 namespace rwd {
 
-    Capturer::Capturer()
+    namespace {
+        // Packet-time seconds between clock ticks sent to every worker
+        constexpr double kWorkerTickInterval = 1.0;
+    }
+
+    Capturer::Capturer(size_t workerThreads, const BodyLimits& bodyLimits, const FlowTimeouts& timeouts)
         : device_(nullptr)
-        , tcpReassembly_(nullptr)
+        , replaySpeed_(0.0)
+        , stopRequested_(false)
+        , finished_(false)
+        , workerThreads_(workerThreads)
+        , bodyLimits_(bodyLimits)
+        , timeouts_(timeouts)
+        , nextWorkerTick_(0.0)
         , packetCount_(0)
-        , httpMessageCount_(0)
     {
     }
 
@@ -63,155 +75,312 @@ namespace rwd {
         return true;
     }
 
-    void Capturer::stopCapture()
+    bool Capturer::openRing(size_t interfaceIndex, const RingConfig& ringConfig)
     {
-        if (device_) {
-            device_->stopCapture();
-            spdlog::info("Capture stopped");
+        auto& deviceList = pcpp::PcapLiveDeviceList::getInstance();
+        auto devices = deviceList.getPcapLiveDevicesList();
+
+        if (interfaceIndex >= devices.size()) {
+            spdlog::error("Invalid interface index: {}", interfaceIndex);
+            return false;
+        }
+
+        auto ring = std::make_unique<PacketRing>(ringConfig);
+        if (!ring->open(devices[interfaceIndex]->getName())) {
+            spdlog::error("Failed to open AF_PACKET ring on: {}", devices[interfaceIndex]->getDesc());
+            return false;
         }
+
+        ring_ = std::move(ring);
+        return true;
     }
 
-    void Capturer::close()
+    bool Capturer::openFile(const std::string& path, double replaySpeed)
     {
-        stopCapture();
+        std::unique_ptr<pcpp::IFileReaderDevice> reader(pcpp::IFileReaderDevice::getReader(path));
+        if (!reader || !reader->open()) {
+            spdlog::error("Failed to open capture file: {}", path);
+            return false;
+        }
 
-        if (device_) {
-            device_->close();
-            device_ = nullptr;
+        fileReader_ = std::move(reader);
+        replaySpeed_ = replaySpeed;
+
+        if (replaySpeed_ > 0.0) {
+            spdlog::info("Opened capture file: {} (paced replay at {}x)", path, replaySpeed_);
+        } else {
+            spdlog::info("Opened capture file: {} (max-speed replay)", path);
         }
+        return true;
+    }
 
-        tcpReassembly_.reset();
-        connectionMap_.clear();
+    bool Capturer::isValidFilter(const std::string& bpfFilter)
+    {
+        pcpp::BPFStringFilter filter(bpfFilter);
+        return filter.verifyFilter();
     }
 
-    void Capturer::onPacketArrivesStatic(
-        void* rawPacket,
-        void* pcapLiveDevice,
-        void* userCookie)
+    bool Capturer::setFilter(const std::string& bpfFilter)
     {
-        auto* capturer = static_cast<Capturer*>(userCookie);
-        capturer->packetCount_++;
+        if (ring_) {
+            return ring_->setFilter(bpfFilter);
+        }
 
-        auto* raw = static_cast<pcpp::RawPacket*>(rawPacket);
-        pcpp::Packet packet(raw);
+        if (fileReader_) {
+            pcpp::BPFStringFilter filter(bpfFilter);
+            if (!fileReader_->setFilter(filter)) {
+                spdlog::error("Failed to set BPF filter '{}' on {}", bpfFilter, fileReader_->getFileName());
+                return false;
+            }
 
-        if (packet.isPacketOfType(pcpp::TCP)) {
-            capturer->tcpReassembly_->reassemblePacket(packet);
+            spdlog::info("BPF filter set on {}: {}", fileReader_->getFileName(), bpfFilter);
+            return true;
         }
+
+        if (!device_) {
+            spdlog::error("Device not opened!");
+            return false;
+        }
+
+        // Compiled and attached in the kernel, so non-matching packets are never
+        // copied to user space
+        pcpp::BPFStringFilter filter(bpfFilter);
+        if (!device_->setFilter(filter)) {
+            spdlog::error("Failed to set BPF filter '{}' on {}", bpfFilter, device_->getDesc());
+            return false;
+        }
+
+        spdlog::info("BPF filter set on {}: {}", device_->getDesc(), bpfFilter);
+        return true;
     }
 
-    void Capturer::onTcpMessageReadyStatic(
-        int8_t side,
-        const pcpp::TcpStreamData& tcpData,
-        void* userCookie)
+    bool Capturer::joinFanout(uint16_t groupId)
     {
-        auto* capturer = static_cast<Capturer*>(userCookie);
-        capturer->onTcpMessageReady(side, tcpData);
+        if (!ring_) {
+            spdlog::error("Fanout groups require the af_packet backend");
+            return false;
+        }
+
+        return ring_->joinFanout(groupId);
     }
 
+    CaptureStats Capturer::getCaptureStats() const
+    {
+        if (ring_) {
+            return ring_->getStats();
+        }
 
-    void Capturer::onTcpMessageReady(int8_t side, const pcpp::TcpStreamData& tcpData) {
-        std::string data(
-            reinterpret_cast<const char*>(tcpData.getData()),
-            tcpData.getDataLength()
-        );
+        CaptureStats result;
+        if (fileReader_) {
+            result.packetsReceived = static_cast<uint64_t>(getPacketCount());
+            return result;
+        }
 
-        bool isClientToServer = (side == 0);
-        HttpMessage msg = HttpMessage::parseFromData(data, isClientToServer);
+        if (!device_) {
+            return result;
+        }
 
-        if (msg.isValid()) {
-            httpMessageCount_++;
+        pcpp::IPcapDevice::PcapStats stats{};
+        device_->getStatistics(stats);
 
-            const pcpp::ConnectionData& connData = tcpData.getConnectionData();
-            uint32_t flowKey = connData.flowKey;
+        result.packetsReceived = stats.packetsRecv;
+        result.packetsDropped = stats.packetsDrop;
+        result.packetsDroppedByInterface = stats.packetsDropByInterface;
+        return result;
+    }
 
-            std::string clientIp = "unknown";
-            int clientPort = 0;
-            std::string serverIp = "unknown";
-            int serverPort = 0;
+    void Capturer::stopCapture()
+    {
+        if (device_) {
+            device_->stopCapture();
+            spdlog::info("Capture stopped");
+        }
 
-            auto it = connectionMap_.find(flowKey);
-            if (it != connectionMap_.end()) {
-                const ConnectionInfo& info = it->second;
-                clientIp = info.clientIp;
-                clientPort = info.clientPort;
-                serverIp = info.serverIp;
-                serverPort = info.serverPort;
-            }
-            else {
-                if (isClientToServer) {
-                    clientIp = connData.srcIP.toString();
-                    clientPort = connData.srcPort;
-                    serverIp = connData.dstIP.toString();
-                    serverPort = connData.dstPort;
-                }
-                else {
-                    clientIp = connData.dstIP.toString();
-                    clientPort = connData.dstPort;
-                    serverIp = connData.srcIP.toString();
-                    serverPort = connData.srcPort;
-                }
-            }
+        if (ring_) {
+            ring_->stop();
+            spdlog::info("Capture stopped");
+        }
 
-            bool isRequest = (msg.getType() == HttpMessage::Type::Request);
+        stopRequested_ = true;
+        if (replayThread_.joinable()) {
+            replayThread_.join();
+            spdlog::info("Replay stopped");
+        }
 
-            if (httpCallback_) {
-                httpCallback_(msg, clientIp, clientPort, serverIp, serverPort, isRequest);
-            }
+        for (auto& worker : workers_) {
+            worker->stop();
         }
     }
 
+    void Capturer::close()
+    {
+        stopCapture();
+
+        if (device_) {
+            device_->close();
+            device_ = nullptr;
+        }
+
+        ring_.reset();
+
+        if (fileReader_) {
+            fileReader_->close();
+            fileReader_.reset();
+        }
+
+        workers_.clear();
+    }
 
-    void Capturer::onTcpConnectionStartStatic(
-        const pcpp::ConnectionData& connectionData,
+    void Capturer::onPacketArrivesStatic(
+        void* rawPacket,
+        void* pcapLiveDevice,
         void* userCookie)
     {
         auto* capturer = static_cast<Capturer*>(userCookie);
+        capturer->packetCount_.fetch_add(1, std::memory_order_relaxed);
+        capturer->dispatchPacket(static_cast<pcpp::RawPacket*>(rawPacket));
+    }
 
-        ConnectionInfo info;
+    void Capturer::dispatchPacket(pcpp::RawPacket* rawPacket)
+    {
+        if (workerThreads_ == 0) {
+            workers_.front()->processPacket(rawPacket);
+            return;
+        }
 
-        info.clientIp = connectionData.srcIP.toString();
-        info.clientPort = connectionData.srcPort;
-        info.serverIp = connectionData.dstIP.toString();
-        info.serverPort = connectionData.dstPort;
+        // Only parse as far as the TCP header; the worker does the full parse
+        pcpp::Packet packet(rawPacket, false, pcpp::TCP);
+        if (!packet.isPacketOfType(pcpp::TCP)) {
+            return;
+        }
 
-        uint32_t flowKey = connectionData.flowKey;
-        capturer->connectionMap_[flowKey] = info;
+        // hash5Tuple is symmetric unless asked otherwise, so both directions
+        // of a connection land on the same worker. A replayed file waits for
+        // a busy worker rather than dropping what it cannot take yet.
+        uint32_t hash = pcpp::hash5Tuple(&packet);
+        workers_[hash % workers_.size()]->enqueue(*rawPacket, fileReader_ != nullptr);
+
+        // A worker only sees the clock move on its own shard's packets; a
+        // shard with no traffic would otherwise never expire its flows
+        timespec ts = rawPacket->getPacketTimeStamp();
+        double packetTime = static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+        if (packetTime >= nextWorkerTick_) {
+            for (auto& worker : workers_) {
+                worker->tick(packetTime);
+            }
+            nextWorkerTick_ = packetTime + kWorkerTickInterval;
+        }
+    }
 
-        spdlog::debug("TCP connection started: {}:{} -> {}:{}",
-            info.clientIp, info.clientPort,
-            info.serverIp, info.serverPort);
+    int Capturer::getHttpMessageCount() const
+    {
+        int total = 0;
+        for (const auto& worker : workers_) {
+            total += worker->getHttpMessageCount();
+        }
+        return total;
     }
 
-    void Capturer::onTcpConnectionEndStatic(
-        const pcpp::ConnectionData& connectionData,
-        pcpp::TcpReassembly::ConnectionEndReason reason,
-        void* userCookie)
+    int Capturer::getDroppedPacketCount() const
     {
-        auto* capturer = static_cast<Capturer*>(userCookie);
+        int total = 0;
+        for (const auto& worker : workers_) {
+            total += worker->getDroppedPacketCount();
+        }
+        return total;
+    }
 
-        uint32_t flowKey = connectionData.flowKey;
-        capturer->connectionMap_.erase(flowKey);
+    size_t Capturer::getExpiredFlowCount() const
+    {
+        size_t total = 0;
+        for (const auto& worker : workers_) {
+            total += worker->getExpiredFlowCount();
+        }
+        return total;
+    }
+
+    void Capturer::replayFile()
+    {
+        using Clock = std::chrono::steady_clock;
+
+        pcpp::RawPacket rawPacket;
+        bool havePacing = false;
+        double firstPacketTime = 0.0;
+        Clock::time_point replayStart;
+
+        while (!stopRequested_ && fileReader_->getNextPacket(rawPacket)) {
+            if (replaySpeed_ > 0.0) {
+                timespec ts = rawPacket.getPacketTimeStamp();
+                double packetTime = ts.tv_sec + ts.tv_nsec / 1e9;
+
+                if (!havePacing) {
+                    firstPacketTime = packetTime;
+                    replayStart = Clock::now();
+                    havePacing = true;
+                }
 
-        spdlog::debug("TCP connection ended: flowKey={}", flowKey);
+                auto offset = std::chrono::duration<double>((packetTime - firstPacketTime) / replaySpeed_);
+                auto due = replayStart + std::chrono::duration_cast<Clock::duration>(offset);
+                if (due > Clock::now()) {
+                    std::this_thread::sleep_until(due);
+                }
+            }
+
+            packetCount_.fetch_add(1, std::memory_order_relaxed);
+            dispatchPacket(&rawPacket);
+        }
+
+        // Workers drain their queues before the file counts as consumed
+        for (auto& worker : workers_) {
+            worker->stop();
+        }
+
+        finished_.store(true, std::memory_order_release);
+        spdlog::info("Finished reading capture file ({} packets)", getPacketCount());
     }
 
-    bool Capturer::startCapture(HttpMessageCallback callback) {
-        if (!device_) {
+    bool Capturer::startCapture(HttpMessageCallback callback, FlowEndCallback onFlowEnd) {
+        if (!device_ && !ring_ && !fileReader_) {
             spdlog::error("Device not opened!");
             return false;
         }
 
-        httpCallback_ = callback;
+        workers_.clear();
+        nextWorkerTick_ = 0.0;
 
-        tcpReassembly_ = std::make_unique<pcpp::TcpReassembly>(
-            onTcpMessageReadyStatic,
-            this,
-            onTcpConnectionStartStatic,
-            onTcpConnectionEndStatic
-        );
+        if (workerThreads_ == 0) {
+            workers_.push_back(std::make_unique<CaptureWorker>(0, callback, bodyLimits_, timeouts_));
+            workers_.back()->setFlowEndCallback(onFlowEnd);
+            workers_.back()->setOffline(fileReader_ != nullptr);
+        }
+        else {
+            for (size_t i = 0; i < workerThreads_; i++) {
+                workers_.push_back(std::make_unique<CaptureWorker>(i, callback, bodyLimits_, timeouts_));
+                workers_.back()->setFlowEndCallback(onFlowEnd);
+                workers_.back()->setOffline(fileReader_ != nullptr);
+                workers_.back()->start();
+            }
+            spdlog::info("Sharding flows across {} worker threads", workerThreads_);
+        }
 
-        if (!device_->startCapture(onPacketArrivesStatic, this)) {
+        if (ring_) {
+            // Ring packets point into the mmap'd block; in inline mode they go
+            // through reassembly without being copied
+            bool started = ring_->start([this](pcpp::RawPacket* rawPacket) {
+                packetCount_.fetch_add(1, std::memory_order_relaxed);
+                dispatchPacket(rawPacket);
+            });
+            if (!started) {
+                spdlog::error("Failed to start capture!");
+                return false;
+            }
+        }
+        else if (fileReader_) {
+            stopRequested_ = false;
+            finished_ = false;
+            replayThread_ = std::thread(&Capturer::replayFile, this);
+        }
+        else if (!device_->startCapture(onPacketArrivesStatic, this)) {
             spdlog::error("Failed to start capture!");
             return false;
         }
@@ -0,0 +1,64 @@
+#include "rewind/capture/FlowKey.h"
+#include "IpAddress.h"
+#include <cstring>
+
+namespace rwd {
+
+    namespace {
+        inline uint64_t mix(uint64_t h, uint64_t word)
+        {
+            h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+            return h ^ (h >> 32);
+        }
+
+        inline uint64_t load64(const uint8_t* bytes)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes, sizeof(word));
+            return word;
+        }
+
+        std::string formatAddress(const std::array<uint8_t, 16>& address, uint8_t ipVersion)
+        {
+            if (ipVersion == 6) {
+                return pcpp::IPv6Address(address.data()).toString();
+            }
+            return pcpp::IPv4Address(address.data()).toString();
+        }
+    }
+
+    size_t FlowKey::hash() const
+    {
+        uint64_t h = ipVersion;
+        h = mix(h, load64(clientAddress.data()));
+        h = mix(h, load64(serverAddress.data()));
+        if (ipVersion == 6) {
+            h = mix(h, load64(clientAddress.data() + 8));
+            h = mix(h, load64(serverAddress.data() + 8));
+        }
+        h = mix(h, (static_cast<uint64_t>(clientPort) << 16) | serverPort);
+        return static_cast<size_t>(h);
+    }
+
+    std::string FlowKey::clientIp() const
+    {
+        return formatAddress(clientAddress, ipVersion);
+    }
+
+    std::string FlowKey::serverIp() const
+    {
+        return formatAddress(serverAddress, ipVersion);
+    }
+
+    std::string FlowKey::toString() const
+    {
+        return clientIp() + ":" + std::to_string(clientPort) + "->" +
+            serverIp() + ":" + std::to_string(serverPort);
+    }
+
+    std::string FlowKey::sessionId(int64_t startMicros) const
+    {
+        return toString() + "@" + std::to_string(startMicros);
+    }
+
+}
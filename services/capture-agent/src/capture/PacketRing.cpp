@@ -0,0 +1,322 @@
+#include "rewind/capture/PacketRing.h"
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <pcap.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace rwd {
+
+#ifdef __linux__
+    namespace {
+        // Nominal frame size; TPACKET_V3 packs variable-length frames into
+        // blocks, but the kernel still validates block_size % frame_size
+        constexpr unsigned int kFrameSize = 2048;
+        constexpr int kPollTimeoutMs = 100;
+    }
+#endif
+
+    PacketRing::PacketRing(const RingConfig& config)
+        : config_(config)
+        , fd_(-1)
+        , ring_(nullptr)
+        , ringSize_(0)
+        , running_(false)
+        , packetsReceived_(0)
+        , packetsDropped_(0)
+    {
+    }
+
+    PacketRing::~PacketRing()
+    {
+        close();
+    }
+
+    bool PacketRing::isSupported()
+    {
+#ifdef __linux__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+#ifdef __linux__
+
+    bool PacketRing::open(const std::string& interfaceName)
+    {
+        long pageSize = ::sysconf(_SC_PAGESIZE);
+        if (config_.blockSize == 0 || config_.blockSize % pageSize != 0) {
+            spdlog::error("Ring block size {} must be a multiple of the page size ({})",
+                config_.blockSize, pageSize);
+            return false;
+        }
+
+        if (config_.blockSize % kFrameSize != 0) {
+            spdlog::error("Ring block size {} must be a multiple of the frame size ({})",
+                config_.blockSize, kFrameSize);
+            return false;
+        }
+
+        if (config_.blockCount == 0) {
+            spdlog::error("Ring block count must be greater than zero");
+            return false;
+        }
+
+        unsigned int ifIndex = ::if_nametoindex(interfaceName.c_str());
+        if (ifIndex == 0) {
+            spdlog::error("Unknown interface for AF_PACKET capture: {}", interfaceName);
+            return false;
+        }
+
+        fd_ = ::socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+        if (fd_ < 0) {
+            spdlog::error("Failed to create AF_PACKET socket: {}", std::strerror(errno));
+            return false;
+        }
+
+        int version = TPACKET_V3;
+        if (::setsockopt(fd_, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0) {
+            spdlog::error("Failed to select TPACKET_V3: {}", std::strerror(errno));
+            close();
+            return false;
+        }
+
+        tpacket_req3 req{};
+        req.tp_block_size = static_cast<unsigned int>(config_.blockSize);
+        req.tp_block_nr = static_cast<unsigned int>(config_.blockCount);
+        req.tp_frame_size = kFrameSize;
+        req.tp_frame_nr = static_cast<unsigned int>(config_.blockSize / kFrameSize * config_.blockCount);
+        req.tp_retire_blk_tov = static_cast<unsigned int>(config_.retireTimeoutMs);
+        req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+        if (::setsockopt(fd_, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) {
+            spdlog::error("Failed to set up RX ring ({} x {} bytes): {}",
+                config_.blockCount, config_.blockSize, std::strerror(errno));
+            close();
+            return false;
+        }
+
+        ringSize_ = config_.blockSize * config_.blockCount;
+        void* mapped = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mapped == MAP_FAILED) {
+            spdlog::error("Failed to mmap RX ring: {}", std::strerror(errno));
+            ringSize_ = 0;
+            close();
+            return false;
+        }
+        ring_ = static_cast<uint8_t*>(mapped);
+
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_ALL);
+        addr.sll_ifindex = static_cast<int>(ifIndex);
+
+        if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            spdlog::error("Failed to bind AF_PACKET socket to {}: {}", interfaceName, std::strerror(errno));
+            close();
+            return false;
+        }
+
+        interfaceName_ = interfaceName;
+        spdlog::info("Opened TPACKET_V3 ring on {}: {} blocks x {} bytes, retire timeout {}ms",
+            interfaceName_, config_.blockCount, config_.blockSize, config_.retireTimeoutMs);
+        return true;
+    }
+
+    bool PacketRing::setFilter(const std::string& bpfFilter)
+    {
+        if (fd_ < 0) {
+            spdlog::error("Ring not opened!");
+            return false;
+        }
+
+        pcap_t* dead = ::pcap_open_dead(DLT_EN10MB, 65535);
+        if (!dead) {
+            spdlog::error("Failed to create pcap handle for filter compilation");
+            return false;
+        }
+
+        bpf_program program{};
+        if (::pcap_compile(dead, &program, bpfFilter.c_str(), 1, PCAP_NETMASK_UNKNOWN) != 0) {
+            spdlog::error("Failed to compile BPF filter '{}': {}", bpfFilter, ::pcap_geterr(dead));
+            ::pcap_close(dead);
+            return false;
+        }
+
+        sock_fprog fprog{};
+        fprog.len = static_cast<unsigned short>(program.bf_len);
+        fprog.filter = reinterpret_cast<sock_filter*>(program.bf_insns);
+
+        int result = ::setsockopt(fd_, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+
+        ::pcap_freecode(&program);
+        ::pcap_close(dead);
+
+        if (result != 0) {
+            spdlog::error("Failed to attach BPF filter on {}: {}", interfaceName_, std::strerror(errno));
+            return false;
+        }
+
+        spdlog::info("BPF filter set on {}: {}", interfaceName_, bpfFilter);
+        return true;
+    }
+
+    bool PacketRing::joinFanout(uint16_t groupId)
+    {
+        if (fd_ < 0) {
+            spdlog::error("Ring not opened!");
+            return false;
+        }
+
+        // DEFRAG reassembles IP fragments first so every fragment of a packet
+        // hashes to the same member
+        int fanoutArg = groupId | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+        if (::setsockopt(fd_, SOL_PACKET, PACKET_FANOUT, &fanoutArg, sizeof(fanoutArg)) != 0) {
+            spdlog::error("Failed to join fanout group {} on {}: {}",
+                groupId, interfaceName_, std::strerror(errno));
+            return false;
+        }
+
+        spdlog::info("Joined PACKET_FANOUT_HASH group {} on {}", groupId, interfaceName_);
+        return true;
+    }
+
+    bool PacketRing::start(PacketHandler handler)
+    {
+        if (!ring_) {
+            spdlog::error("Ring not opened!");
+            return false;
+        }
+
+        if (running_.exchange(true)) {
+            return true;
+        }
+
+        handler_ = std::move(handler);
+        thread_ = std::thread(&PacketRing::run, this);
+        return true;
+    }
+
+    void PacketRing::stop()
+    {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    void PacketRing::close()
+    {
+        stop();
+
+        if (ring_) {
+            ::munmap(ring_, ringSize_);
+            ring_ = nullptr;
+            ringSize_ = 0;
+        }
+
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    CaptureStats PacketRing::getStats() const
+    {
+        if (fd_ >= 0) {
+            tpacket_stats_v3 stats{};
+            socklen_t len = sizeof(stats);
+            if (::getsockopt(fd_, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0) {
+                packetsReceived_ += stats.tp_packets;
+                packetsDropped_ += stats.tp_drops;
+            }
+        }
+
+        CaptureStats result;
+        result.packetsReceived = packetsReceived_;
+        result.packetsDropped = packetsDropped_;
+        return result;
+    }
+
+    void PacketRing::run()
+    {
+        size_t blockIndex = 0;
+
+        while (running_) {
+            uint8_t* block = ring_ + blockIndex * config_.blockSize;
+            auto* desc = reinterpret_cast<tpacket_block_desc*>(block);
+
+            if ((__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
+                pollfd pfd{};
+                pfd.fd = fd_;
+                pfd.events = POLLIN | POLLERR;
+                ::poll(&pfd, 1, kPollTimeoutMs);
+                continue;
+            }
+
+            processBlock(block);
+
+            // Give the block back to the kernel only after every packet in it
+            // has been consumed, since handlers read directly from the ring
+            __atomic_store_n(&desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            blockIndex = (blockIndex + 1) % config_.blockCount;
+        }
+    }
+
+    void PacketRing::processBlock(uint8_t* block)
+    {
+        auto* desc = reinterpret_cast<tpacket_block_desc*>(block);
+        uint32_t packetCount = desc->hdr.bh1.num_pkts;
+        uint8_t* frame = block + desc->hdr.bh1.offset_to_first_pkt;
+
+        for (uint32_t i = 0; i < packetCount; i++) {
+            auto* header = reinterpret_cast<tpacket3_hdr*>(frame);
+
+            timespec timestamp{};
+            timestamp.tv_sec = header->tp_sec;
+            timestamp.tv_nsec = header->tp_nsec;
+
+            pcpp::RawPacket rawPacket(
+                frame + header->tp_mac,
+                static_cast<int>(header->tp_snaplen),
+                timestamp,
+                false
+            );
+            handler_(&rawPacket);
+
+            frame += header->tp_next_offset;
+        }
+    }
+
+#else
+
+    bool PacketRing::open(const std::string& interfaceName)
+    {
+        spdlog::error("AF_PACKET capture is only available on Linux (requested for {})", interfaceName);
+        return false;
+    }
+
+    bool PacketRing::setFilter(const std::string&) { return false; }
+    bool PacketRing::joinFanout(uint16_t) { return false; }
+    bool PacketRing::start(PacketHandler) { return false; }
+    void PacketRing::stop() {}
+    void PacketRing::close() {}
+    CaptureStats PacketRing::getStats() const { return {}; }
+    void PacketRing::run() {}
+    void PacketRing::processBlock(uint8_t*) {}
+
+#endif
+
+}
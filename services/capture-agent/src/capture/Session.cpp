@@ -1,19 +1,21 @@
 #include "rewind/capture/Session.h"
+#include "rewind/output/JsonWriter.h"
+#include <cmath>
 #include <spdlog/spdlog.h>
 
 namespace rwd {
 
-    nlohmann::json HttpTransaction::toJson() const 
+    nlohmann::json HttpTransaction::toJson(const BodyOptions& bodyOptions) const
     {
         nlohmann::json j;
 
         if (hasRequest()) {
-            j["request"] = request_.toJson();
+            j["request"] = request_.toJson(bodyOptions);
             j["requestTime"] = requestTime_;
         }
 
         if (hasResponse()) {
-            j["response"] = response_.toJson();
+            j["response"] = response_.toJson(bodyOptions);
             j["responseTime"] = responseTime_;
         }
 
@@ -24,78 +26,125 @@ namespace rwd {
         return j;
     }
 
-    Session::Session(const std::string& sessionId,
-        const std::string& clientIp, int clientPort,
-        const std::string& serverIp, int serverPort)
-        : sessionId_(sessionId)
-        , clientIp_(clientIp)
-        , clientPort_(clientPort)
-        , serverIp_(serverIp)
-        , serverPort_(serverPort)
+    void HttpTransaction::writeJson(JsonWriter& writer, const BodyOptions& bodyOptions) const
+    {
+        writer.beginObject();
+
+        if (hasRequest()) {
+            writer.key("request");
+            request_.writeJson(writer, bodyOptions);
+            writer.field("requestTime", requestTime_);
+        }
+
+        if (hasResponse()) {
+            writer.key("response");
+            response_.writeJson(writer, bodyOptions);
+            writer.field("responseTime", responseTime_);
+        }
+
+        if (isComplete()) {
+            writer.field("duration", duration_);
+        }
+
+        writer.endObject();
+    }
+
+    Session::Session(const FlowKey& flow)
+        : flow_(flow)
         , startTime_(0.0)
         , endTime_(0.0)
         , closed_(false)
-        , currentTransaction_(nullptr)
+        , transactions_(&arena_)
+        , pendingRequests_(&arena_)
     {
     }
 
-    void Session::addRequest(const HttpMessage& msg, double timestamp) 
+    bool Session::claimSource(size_t sourceId, bool isRequest)
     {
+        std::optional<size_t>& owner = isRequest ? requestSource_ : responseSource_;
+        if (!owner.has_value()) {
+            owner = sourceId;
+        }
+        return owner.value() == sourceId;
+    }
+
+    void Session::touch(double timestamp)
+    {
+        // The first message starts the session, even a response whose
+        // request was never captured
         if (startTime_ == 0.0) {
             startTime_ = timestamp;
         }
         endTime_ = timestamp;
+    }
 
-        transactions_.emplace_back();
-        currentTransaction_ = &transactions_.back();
-        currentTransaction_->setRequest(msg, timestamp);
+    void Session::addRequest(HttpMessage&& msg, double timestamp) 
+    {
+        touch(timestamp);
 
         spdlog::debug("Session {}: Added request {} {}",
-            sessionId_, msg.getMethod(), msg.getUri());
+            flow_, msg.getMethod(), msg.getUri());
+
+        transactions_.emplace_back();
+        transactions_.back().setRequest(std::move(msg), timestamp);
+        pendingRequests_.push_back(transactions_.size() - 1);
     }
 
-    void Session::addResponse(const HttpMessage& msg, double timestamp) 
+    void Session::addResponse(HttpMessage&& msg, double timestamp) 
     {
-        endTime_ = timestamp;
+        touch(timestamp);
 
-        if (currentTransaction_ && !currentTransaction_->hasResponse()) 
+        if (!pendingRequests_.empty()) 
         {
-            currentTransaction_->setResponse(msg, timestamp);
+            HttpTransaction& transaction = transactions_[pendingRequests_.front()];
+            pendingRequests_.pop_front();
 
-            spdlog::debug("Session {}: Added response {} ({}ms)",
-                sessionId_,
-                msg.getStatusCode(),
-                static_cast<int>(currentTransaction_->getDuration() * 1000));
+            transaction.setResponse(std::move(msg), timestamp);
 
-            currentTransaction_ = nullptr; 
+            spdlog::debug("Session {}: Added response {} ({}ms)",
+                flow_,
+                transaction.getResponse().getStatusCode(),
+                static_cast<int>(transaction.getDuration() * 1000));
         }
         else 
         {
-            spdlog::warn("Session {}: Received response without matching request", sessionId_);
+            spdlog::warn("Session {}: Received response without matching request", flow_);
 
             transactions_.emplace_back();
-            transactions_.back().setResponse(msg, timestamp);
+            transactions_.back().setResponse(std::move(msg), timestamp);
         }
     }
 
     void Session::close() 
     {
         closed_ = true;
-        spdlog::debug("Session {} closed: {} transactions, {:.2f}s duration",
-            sessionId_,
+        spdlog::debug("Session {} closed: {} transactions, {:.2f}s duration, arena {}/{} bytes used",
+            flow_,
             transactions_.size(),
-            getDuration());
+            getDuration(),
+            arena_.getUsedBytes(),
+            arena_.getReservedBytes());
     }
 
-    nlohmann::json Session::toJson() const 
+    std::string Session::getSessionId() const
+    {
+        // Microseconds, as kept by the segment format, so the id survives it
+        return flow_.sessionId(std::llround(startTime_ * 1e6));
+    }
+
+    nlohmann::json Session::toJson(const BodyOptions& bodyOptions) const
     {
         nlohmann::json j;
 
-        j["sessionId"] = sessionId_;
-        j["clientIp"] = clientIp_;
-        j["clientPort"] = clientPort_;
-        j["serverIp"] = serverIp_;
-        j["serverPort"] = serverPort_;
+        // Addresses are only formatted here, when the session is written out
+        std::string clientIp = flow_.clientIp();
+        std::string serverIp = flow_.serverIp();
+
+        j["sessionId"] = getSessionId();
+        j["clientIp"] = clientIp;
+        j["clientPort"] = flow_.clientPort;
+        j["serverIp"] = serverIp;
+        j["serverPort"] = flow_.serverPort;
         j["startTime"] = startTime_;
         j["endTime"] = endTime_;
         j["duration"] = getDuration();
@@ -107,7 +156,7 @@ namespace rwd {
         {
             if (trans.hasRequest() || trans.hasResponse())
             {
-                transArray.push_back(trans.toJson());
+                transArray.push_back(trans.toJson(bodyOptions));
             }
         }
 
@@ -116,4 +165,34 @@ namespace rwd {
         return j;
     }
 
-}
\ No newline at end of file
+    void Session::writeJson(JsonWriter& writer, const BodyOptions& bodyOptions) const
+    {
+        std::string clientIp = flow_.clientIp();
+        std::string serverIp = flow_.serverIp();
+
+        writer.beginObject();
+        writer.field("sessionId", getSessionId());
+        writer.field("clientIp", clientIp);
+        writer.field("clientPort", flow_.clientPort);
+        writer.field("serverIp", serverIp);
+        writer.field("serverPort", flow_.serverPort);
+        writer.field("startTime", startTime_);
+        writer.field("endTime", endTime_);
+        writer.field("duration", getDuration());
+        writer.field("transactionCount", transactions_.size());
+
+        writer.key("transactions");
+        writer.beginArray();
+        for (const auto& trans : transactions_)
+        {
+            if (trans.hasRequest() || trans.hasResponse())
+            {
+                trans.writeJson(writer, bodyOptions);
+            }
+        }
+        writer.endArray();
+
+        writer.endObject();
+    }
+
+}
@@ -0,0 +1,167 @@
+#include "rewind/capture/SessionArena.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace rwd {
+
+    namespace {
+        // Requests above this bypass the chunks
+        constexpr size_t kLargeThreshold = SessionArena::kChunkSize / 4;
+        // 4 MB of idle chunks is kept for the next sessions; the rest is freed
+        constexpr size_t kMaxPooledChunks = 256;
+
+        struct ChunkPool {
+            std::mutex mutex;
+            std::vector<char*> free;
+
+            ~ChunkPool() {
+                for (char* chunk : free) {
+                    delete[] chunk;
+                }
+            }
+        };
+
+        ChunkPool& chunkPool()
+        {
+            static ChunkPool instance;
+            return instance;
+        }
+
+        std::atomic<size_t> totalReserved{0};
+        std::atomic<size_t> peakReserved{0};
+
+        char* acquireChunk(size_t size)
+        {
+            // Only full-size chunks are pooled
+            if (size != SessionArena::kChunkSize) {
+                return new char[size];
+            }
+
+            {
+                ChunkPool& pool = chunkPool();
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                if (!pool.free.empty()) {
+                    char* chunk = pool.free.back();
+                    pool.free.pop_back();
+                    return chunk;
+                }
+            }
+            return new char[SessionArena::kChunkSize];
+        }
+
+        // Chunk is SessionArena's private chunk record
+        template <typename Chunk>
+        void releaseChunks(std::vector<Chunk>& chunks)
+        {
+            {
+                ChunkPool& pool = chunkPool();
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                for (Chunk& chunk : chunks) {
+                    if (chunk.size == SessionArena::kChunkSize && pool.free.size() < kMaxPooledChunks) {
+                        pool.free.push_back(chunk.data);
+                        chunk.data = nullptr;
+                    }
+                }
+            }
+            for (const Chunk& chunk : chunks) {
+                delete[] chunk.data;
+            }
+            chunks.clear();
+        }
+    }
+
+    SessionArena::SessionArena()
+        : cursor_(nullptr)
+        , end_(nullptr)
+        , nextChunkSize_(kFirstChunkSize)
+        , used_(0)
+        , reserved_(0)
+    {
+    }
+
+    SessionArena::~SessionArena()
+    {
+        for (const LargeBlock& block : large_) {
+            ::operator delete(block.data, block.size, std::align_val_t(block.alignment));
+        }
+        releaseChunks(chunks_);
+        totalReserved.fetch_sub(reserved_, std::memory_order_relaxed);
+    }
+
+    size_t SessionArena::getTotalReservedBytes()
+    {
+        return totalReserved.load(std::memory_order_relaxed);
+    }
+
+    size_t SessionArena::getPeakReservedBytes()
+    {
+        return peakReserved.load(std::memory_order_relaxed);
+    }
+
+    void SessionArena::reserve(size_t bytes)
+    {
+        reserved_ += bytes;
+        size_t total = totalReserved.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = peakReserved.load(std::memory_order_relaxed);
+        while (total > peak && !peakReserved.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+        }
+    }
+
+    void* SessionArena::do_allocate(size_t bytes, size_t alignment)
+    {
+        used_ += bytes;
+
+        if (bytes > kLargeThreshold) {
+            void* data = ::operator new(bytes, std::align_val_t(alignment));
+            large_.push_back(LargeBlock{data, bytes, alignment});
+            reserve(bytes);
+            return data;
+        }
+
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        if (!cursor_ || aligned + bytes > reinterpret_cast<uintptr_t>(end_)) {
+            // Geometric growth, but always big enough for this request
+            size_t size = nextChunkSize_;
+            while (size < bytes + alignment) {
+                size *= 2;
+            }
+            nextChunkSize_ = std::min(size * 2, kChunkSize);
+
+            char* chunk = acquireChunk(size);
+            chunks_.push_back(Chunk{chunk, size});
+            reserve(size);
+            cursor_ = chunk;
+            end_ = chunk + size;
+            aligned = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        }
+
+        cursor_ = reinterpret_cast<char*>(aligned + bytes);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void SessionArena::do_deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        used_ -= bytes;
+
+        if (bytes <= kLargeThreshold) {
+            // Chunk space is only reclaimed with the whole arena
+            return;
+        }
+
+        // Usually the block just replaced by a larger one, so search backwards
+        for (size_t i = large_.size(); i-- > 0; ) {
+            if (large_[i].data == p) {
+                ::operator delete(p, large_[i].size, std::align_val_t(alignment));
+                reserved_ -= large_[i].size;
+                totalReserved.fetch_sub(large_[i].size, std::memory_order_relaxed);
+                large_[i] = large_.back();
+                large_.pop_back();
+                return;
+            }
+        }
+    }
+
+}
@@ -1,12 +1,18 @@
 #include "rewind/capture/SessionManager.h"
 #include <spdlog/spdlog.h>
-#include <chrono>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
 
 namespace rwd {
 
+    namespace {
+        // How long (in packet time) after a session is written out messages
+        // for its flow from other sources are taken as late copies
+        constexpr double kRecentlyClosedSeconds = 5.0;
+    }
+
     SessionManager::SessionManager() 
+        : duplicateMessages_(0)
+        , closedSessions_(0)
     {
     }
 
@@ -15,83 +21,160 @@ namespace rwd {
         closeAllSessions();
     }
 
-    std::string SessionManager::createSessionId(
-        const std::string& clientIp, int clientPort,
-        const std::string& serverIp, int serverPort) const
+    SessionManager::Stripe& SessionManager::stripeFor(const FlowKey& flow)
     {
-        std::ostringstream oss;
-        oss << clientIp << ":" << clientPort << "->"
-            << serverIp << ":" << serverPort;
-        return oss.str();
+        // The top bits: FlowTable places entries by the low ones
+        uint64_t hash = flow.hash();
+        return stripes_[hash >> (64 - kStripeBits)];
     }
 
-    double SessionManager::getCurrentTimestamp() const 
+    bool SessionManager::addMessage(
+        HttpMessage&& msg,
+        const FlowKey& flow,
+        bool isRequest,
+        double timestamp,
+        size_t sourceId)
     {
-        auto now = std::chrono::system_clock::now();
-        auto duration = now.time_since_epoch();
-        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
-        return millis.count() / 1000.0;
+        Stripe& stripe = stripeFor(flow);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        if (isLateCopyLocked(stripe, flow, isRequest, timestamp, sourceId)) {
+            duplicateMessages_.fetch_add(1, std::memory_order_relaxed);
+            spdlog::debug("Session {}: Dropped late {} from source {} after the session closed",
+                flow, isRequest ? "request" : "response", sourceId);
+            return false;
+        }
+
+        auto [slot, inserted] = stripe.sessions.tryEmplace(flow);
+        if (inserted) {
+            *slot = std::make_shared<Session>(flow);
+            spdlog::debug("Created new session: {}", flow);
+        }
+        Session& session = **slot;
+
+        // The same flow can be visible on several interfaces (bond members,
+        // loopback). Whichever source delivers a direction first owns it.
+        if (!session.claimSource(sourceId, isRequest)) {
+            duplicateMessages_.fetch_add(1, std::memory_order_relaxed);
+            spdlog::debug("Session {}: Dropped duplicate {} from source {}",
+                flow, isRequest ? "request" : "response", sourceId);
+            return false;
+        }
+
+        if (isRequest) {
+            session.addRequest(std::move(msg), timestamp);
+        }
+        else {
+            session.addResponse(std::move(msg), timestamp);
+        }
+
+        return true;
     }
 
-    void SessionManager::addMessage(
-        const HttpMessage& msg,
-        const std::string& clientIp, int clientPort,
-        const std::string& serverIp, int serverPort,
-        bool isRequest)
+    void SessionManager::endSession(const FlowKey& flow, size_t sourceId, double timestamp)
     {
-        std::string sessionId = createSessionId(clientIp, clientPort, serverIp, serverPort);
+        std::vector<std::shared_ptr<Session>> closed;
+        {
+            Stripe& stripe = stripeFor(flow);
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            std::shared_ptr<Session>* slot = stripe.sessions.find(flow);
+            if (!slot || !(*slot)->isOwnedBy(sourceId)) {
+                return;
+            }
 
-        auto it = sessions_.find(sessionId);
-        if (it == sessions_.end()) {
-            auto session = std::make_shared<Session>(
-                sessionId, clientIp, clientPort, serverIp, serverPort
-            );
-            sessions_[sessionId] = session;
+            forgetClosedLocked(stripe, timestamp);
+            ClosedFlow& marker = stripe.recentlyClosed.insertOrAssign(flow, ClosedFlow());
+            marker.requestSource = (*slot)->getRequestSource();
+            marker.closedAt = timestamp;
+            stripe.closedOrder.emplace_back(flow, timestamp);
 
-            spdlog::info("Created new session: {}", sessionId);
-            it = sessions_.find(sessionId);
+            closed.push_back(std::move(*slot));
+            stripe.sessions.erase(flow);
         }
 
-        double timestamp = getCurrentTimestamp();
+        finalize(closed);
+    }
 
-        if (isRequest) {
-            it->second->addRequest(msg, timestamp);
+    bool SessionManager::isLateCopyLocked(Stripe& stripe, const FlowKey& flow, bool isRequest, double timestamp,
+        size_t sourceId)
+    {
+        ClosedFlow* marker = stripe.recentlyClosed.find(flow);
+        if (!marker) {
+            return false;
         }
-        else {
-            it->second->addResponse(msg, timestamp);
+
+        if (timestamp - marker->closedAt > kRecentlyClosedSeconds) {
+            stripe.recentlyClosed.erase(flow);
+            return false;
+        }
+
+        // Only a request from the source that captured the requests can be
+        // a new connection reusing the ports; anything else belongs to the
+        // one just written out
+        if (isRequest && (!marker->requestSource.has_value() || *marker->requestSource == sourceId)) {
+            stripe.recentlyClosed.erase(flow);
+            return false;
         }
+        return true;
     }
 
-    std::vector<std::shared_ptr<Session>> SessionManager::getAllSessions() const 
+    void SessionManager::forgetClosedLocked(Stripe& stripe, double now)
     {
-        std::vector<std::shared_ptr<Session>> result;
-        for (const auto& [id, session] : sessions_) {
-            result.push_back(session);
+        while (!stripe.closedOrder.empty() && now - stripe.closedOrder.front().second > kRecentlyClosedSeconds) {
+            const auto& [flow, closedAt] = stripe.closedOrder.front();
+            // The flow may have been closed again since; that marker stays
+            ClosedFlow* marker = stripe.recentlyClosed.find(flow);
+            if (marker && marker->closedAt == closedAt) {
+                stripe.recentlyClosed.erase(flow);
+            }
+            stripe.closedOrder.pop_front();
         }
-        return result;
     }
 
     void SessionManager::closeAllSessions() 
     {
-        for (auto& [id, session] : sessions_) {
-            if (!session->isClosed()) {
-                session->close();
-            }
+        std::vector<std::shared_ptr<Session>> closed;
+        for (Stripe& stripe : stripes_) {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            stripe.sessions.forEach([&closed](const FlowKey&, std::shared_ptr<Session>& session) {
+                closed.push_back(std::move(session));
+            });
+            stripe.sessions.clear();
+            stripe.recentlyClosed.clear();
+            stripe.closedOrder.clear();
         }
+
+        // Oldest first, as they would have closed
+        std::sort(closed.begin(), closed.end(), [](const auto& a, const auto& b) {
+            return a->getStartTime() < b->getStartTime();
+        });
+        finalize(closed);
     }
 
-    nlohmann::json SessionManager::toJson() const 
+    void SessionManager::finalize(std::vector<std::shared_ptr<Session>>& closed)
     {
-        nlohmann::json j;
+        for (auto& session : closed) {
+            session->close();
+            if (sink_) {
+                sink_->write(*session);
+            }
+            if (closedCallback_) {
+                closedCallback_(*session);
+            }
+            closedSessions_.fetch_add(1, std::memory_order_relaxed);
+        }
 
-        j["sessionCount"] = sessions_.size();
+        // Last reference: transactions and payloads are freed here
+        closed.clear();
+    }
 
-        nlohmann::json sessionsArray = nlohmann::json::array();
-        for (const auto& [id, session] : sessions_) {
-            sessionsArray.push_back(session->toJson());
+    size_t SessionManager::getSessionCount() const
+    {
+        size_t total = 0;
+        for (const Stripe& stripe : stripes_) {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            total += stripe.sessions.size();
         }
-        j["sessions"] = sessionsArray;
-
-        return j;
+        return total;
     }
+
 }
@@ -0,0 +1,130 @@
+#include "rewind/capture/TimerWheel.h"
+#include <algorithm>
+
+namespace rwd {
+
+    TimerWheel::TimerWheel(double tickSeconds)
+        : tickSeconds_(tickSeconds)
+        , current_(0)
+        , started_(false)
+        , size_(0)
+        , levelCounts_{}
+    {
+    }
+
+    uint64_t TimerWheel::toTick(double seconds) const
+    {
+        return seconds <= 0.0 ? 0 : static_cast<uint64_t>(seconds / tickSeconds_);
+    }
+
+    void TimerWheel::schedule(uint64_t id, double deadline)
+    {
+        uint64_t tick = toTick(deadline);
+        if (!started_) {
+            // Scheduled before the clock was advanced at all
+            current_ = tick > 0 ? tick - 1 : 0;
+            started_ = true;
+        }
+
+        place(Timer{id, std::max(tick, current_ + 1)});
+        size_++;
+    }
+
+    void TimerWheel::place(const Timer& timer)
+    {
+        uint64_t delta = timer.deadline > current_ ? timer.deadline - current_ : 0;
+
+        // Lowest level whose span covers the delay; anything beyond the top
+        // level waits in its furthest slot and is placed again from there
+        size_t level = 0;
+        while (level + 1 < kLevels && delta >= (uint64_t(1) << (kSlotBits * (level + 1)))) {
+            level++;
+        }
+
+        uint64_t tick = timer.deadline;
+        uint64_t maxTick = current_ + (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+        if (tick > maxTick) {
+            tick = maxTick;
+        }
+        size_t slot = static_cast<size_t>((tick >> (kSlotBits * level)) & (kSlots - 1));
+        slots_[level][slot].push_back(timer);
+        levelCounts_[level]++;
+    }
+
+    void TimerWheel::cascade(size_t level)
+    {
+        size_t slot = static_cast<size_t>((current_ >> (kSlotBits * level)) & (kSlots - 1));
+        std::vector<Timer> timers;
+        timers.swap(slots_[level][slot]);
+        levelCounts_[level] -= timers.size();
+        for (const Timer& timer : timers) {
+            place(timer);
+        }
+    }
+
+    void TimerWheel::advance(double now, const ExpiryCallback& onExpiry)
+    {
+        uint64_t target = toTick(now);
+        if (!started_) {
+            // The packet clock starts at the first timestamp seen
+            current_ = target;
+            started_ = true;
+            return;
+        }
+        if (target <= current_) {
+            return;
+        }
+
+        while (current_ < target) {
+            if (size_ == 0) {
+                // Nothing to fire; skip the idle stretch in one step
+                current_ = target;
+                break;
+            }
+
+            // With the lower levels empty nothing happens before the next
+            // slot boundary of the lowest occupied level
+            size_t occupied = 0;
+            while (occupied + 1 < kLevels && levelCounts_[occupied] == 0) {
+                occupied++;
+            }
+            if (occupied > 0) {
+                uint64_t lastQuiet = current_ | ((uint64_t(1) << (kSlotBits * occupied)) - 1);
+                if (lastQuiet >= target) {
+                    current_ = target;
+                    break;
+                }
+                current_ = lastQuiet;
+            }
+
+            current_++;
+
+            // Refill the lower levels from the level above each time they wrap
+            for (size_t level = kLevels - 1; level > 0; level--) {
+                uint64_t mask = (uint64_t(1) << (kSlotBits * level)) - 1;
+                if ((current_ & mask) == 0) {
+                    cascade(level);
+                }
+            }
+
+            std::vector<Timer>& due = slots_[0][current_ & (kSlots - 1)];
+            if (due.empty()) {
+                continue;
+            }
+
+            firing_.clear();
+            firing_.swap(due);
+            levelCounts_[0] -= firing_.size();
+            for (const Timer& timer : firing_) {
+                if (timer.deadline > current_) {
+                    // Parked in the top level past its range
+                    place(timer);
+                    continue;
+                }
+                size_--;
+                onExpiry(timer.id);
+            }
+        }
+    }
+
+}
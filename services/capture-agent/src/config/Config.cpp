@@ -42,6 +42,122 @@ namespace rwd {
                 if (captureNode["output_directory"]) {
                     capture_.outputDirectory = captureNode["output_directory"].as<std::string>();
                 }
+
+                if (captureNode["output_format"]) {
+                    capture_.outputFormat = captureNode["output_format"].as<std::string>();
+                }
+
+                if (captureNode["ndjson"]) {
+                    auto ndjsonNode = captureNode["ndjson"];
+
+                    if (ndjsonNode["flush_bytes"]) {
+                        capture_.ndjson.flushBytes = ndjsonNode["flush_bytes"].as<size_t>();
+                    }
+
+                    if (ndjsonNode["flush_interval_ms"]) {
+                        capture_.ndjson.flushIntervalMs = ndjsonNode["flush_interval_ms"].as<int>();
+                    }
+
+                    if (ndjsonNode["fsync"]) {
+                        capture_.ndjson.fsync = ndjsonNode["fsync"].as<std::string>();
+                    }
+
+                    if (ndjsonNode["fsync_interval_ms"]) {
+                        capture_.ndjson.fsyncIntervalMs = ndjsonNode["fsync_interval_ms"].as<int>();
+                    }
+                }
+
+                if (captureNode["segment"]) {
+                    auto segmentNode = captureNode["segment"];
+
+                    if (segmentNode["block_bytes"]) {
+                        capture_.segment.blockBytes = segmentNode["block_bytes"].as<size_t>();
+                    }
+
+                    if (segmentNode["flush_interval_ms"]) {
+                        capture_.segment.flushIntervalMs = segmentNode["flush_interval_ms"].as<int>();
+                    }
+
+                    if (segmentNode["rotate_bytes"]) {
+                        capture_.segment.rotateBytes = segmentNode["rotate_bytes"].as<uint64_t>();
+                    }
+
+                    if (segmentNode["rotate_interval_seconds"]) {
+                        capture_.segment.rotateIntervalSeconds = segmentNode["rotate_interval_seconds"].as<int>();
+                    }
+
+                    if (segmentNode["max_age_hours"]) {
+                        capture_.segment.maxAgeHours = segmentNode["max_age_hours"].as<double>();
+                    }
+
+                    if (segmentNode["max_total_bytes"]) {
+                        capture_.segment.maxTotalBytes = segmentNode["max_total_bytes"].as<uint64_t>();
+                    }
+                }
+
+                if (captureNode["worker_threads"]) {
+                    capture_.workerThreads = captureNode["worker_threads"].as<size_t>();
+                }
+
+                if (captureNode["backend"]) {
+                    capture_.backend = captureNode["backend"].as<std::string>();
+                }
+
+                if (captureNode["ring"]) {
+                    auto ringNode = captureNode["ring"];
+
+                    if (ringNode["block_size"]) {
+                        capture_.ring.blockSize = ringNode["block_size"].as<size_t>();
+                    }
+
+                    if (ringNode["block_count"]) {
+                        capture_.ring.blockCount = ringNode["block_count"].as<size_t>();
+                    }
+
+                    if (ringNode["retire_timeout_ms"]) {
+                        capture_.ring.retireTimeoutMs = ringNode["retire_timeout_ms"].as<int>();
+                    }
+                }
+
+                if (captureNode["fanout"]) {
+                    auto fanoutNode = captureNode["fanout"];
+
+                    if (fanoutNode["group_id"]) {
+                        capture_.fanout.groupId = fanoutNode["group_id"].as<uint16_t>();
+                    }
+
+                    if (fanoutNode["member_index"]) {
+                        capture_.fanout.memberIndex = fanoutNode["member_index"].as<size_t>();
+                    }
+                }
+
+                if (captureNode["idle_timeouts"]) {
+                    auto timeoutsNode = captureNode["idle_timeouts"];
+
+                    if (timeoutsNode["handshake"]) {
+                        capture_.idleTimeouts.handshakeSeconds = timeoutsNode["handshake"].as<int>();
+                    }
+
+                    if (timeoutsNode["established"]) {
+                        capture_.idleTimeouts.establishedSeconds = timeoutsNode["established"].as<int>();
+                    }
+
+                    if (timeoutsNode["half_closed"]) {
+                        capture_.idleTimeouts.halfClosedSeconds = timeoutsNode["half_closed"].as<int>();
+                    }
+                }
+
+                if (captureNode["payload_pool"]) {
+                    auto poolNode = captureNode["payload_pool"];
+
+                    if (poolNode["max_buffers"]) {
+                        capture_.payloadPool.maxBuffers = poolNode["max_buffers"].as<size_t>();
+                    }
+
+                    if (poolNode["max_buffer_size"]) {
+                        capture_.payloadPool.maxBufferSize = poolNode["max_buffer_size"].as<size_t>();
+                    }
+                }
             }
 
             if (config["filters"]) {
@@ -59,6 +175,10 @@ namespace rwd {
                     filter_.maxBodySize = filtersNode["max_body_size"].as<size_t>();
                 }
 
+                if (filtersNode["decompress_body"]) {
+                    filter_.decompressBody = filtersNode["decompress_body"].as<bool>();
+                }
+
                 if (filtersNode["bpf_filter"]) {
                     filter_.bpfFilter = filtersNode["bpf_filter"].as<std::string>();
                 }
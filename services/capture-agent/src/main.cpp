@@ -1,21 +1,26 @@
 #include "rewind/capture/Capturer.h"
 #include "rewind/parsers/HttpMessage.h"
+#include "rewind/parsers/PayloadBuffer.h"
 #include "rewind/capture/SessionManager.h"
 #include "rewind/config/Config.h"
 #include "rewind/metrics/MetricsServer.h"
+#include "rewind/output/JsonFileSink.h"
+#include "rewind/output/NdjsonFileSink.h"
+#include "rewind/output/SegmentFileSink.h"
 #include <iostream>
 #include <thread>
-#include <iomanip>
 #include <chrono>
-#include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <vector>
 #include <spdlog/spdlog.h>
-#include <nlohmann/json.hpp>
 
 void printUsage(const char* programName) {
     std::cout << "Usage: " << programName << " [options]\n"
               << "Options:\n"
               << "  --config <file>    Path to configuration file (default: config/config.yaml)\n"
+              << "  --input <file>     Read packets from a pcap/pcapng file instead of a live interface\n"
+              << "  --speed <factor>   Replay --input at <factor> x the captured rate (default: 0 = as fast as possible)\n"
               << "  --help             Show this help message\n";
 }
 
@@ -29,6 +34,8 @@ spdlog::level::level_enum parseLogLevel(const std::string& level) {
 
 int main(int argc, char* argv[]) {
     std::string configFile = "config/config.yaml";
+    std::string inputFile;
+    double replaySpeed = 0.0;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -37,6 +44,18 @@ int main(int argc, char* argv[]) {
             return 0;
         } else if (arg == "--config" && i + 1 < argc) {
             configFile = argv[++i];
+        } else if (arg == "--input" && i + 1 < argc) {
+            inputFile = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            try {
+                replaySpeed = std::stod(argv[++i]);
+            } catch (...) {
+                replaySpeed = -1.0;
+            }
+            if (replaySpeed < 0.0) {
+                std::cerr << "Invalid --speed value: " << argv[i] << std::endl;
+                return 1;
+            }
         } else {
             std::cerr << "Unknown argument: " << arg << std::endl;
             printUsage(argv[0]);
@@ -70,100 +89,334 @@ int main(int argc, char* argv[]) {
     }
 
     rwd::SessionManager sessionManager;
-    rwd::Capturer capturer;
 
-    auto interfaces = rwd::Capturer::getAvailableInterfaces();
-    spdlog::info("Found {} network interfaces", interfaces.size());
+    // Bodies are cut to max_body_size as they are reassembled
+    rwd::BodyLimits bodyLimits;
+    bodyLimits.captureBody = config.getFilter().captureBody;
+    bodyLimits.maxBodySize = config.getFilter().maxBodySize;
+
+    // Connections that go quiet are closed by the capture workers
+    const rwd::IdleTimeoutConfig& idleTimeouts = config.getIdleTimeouts();
+    rwd::FlowTimeouts flowTimeouts;
+    flowTimeouts.handshake = idleTimeouts.handshakeSeconds;
+    flowTimeouts.established = idleTimeouts.establishedSeconds;
+    flowTimeouts.halfClosed = idleTimeouts.halfClosedSeconds;
+
+    const rwd::PayloadPoolConfig& payloadPool = config.getPayloadPool();
+    rwd::PayloadBuffer::configurePool(payloadPool.maxBuffers, payloadPool.maxBufferSize);
+
+    rwd::BodyOptions bodyOptions;
+    bodyOptions.decompress = config.getFilter().decompressBody;
+    bodyOptions.maxDecodedSize = config.getFilter().maxBodySize;
+
+    bool ndjson = config.getOutputFormat() == "ndjson";
+    bool segment = config.getOutputFormat() == "segment";
+    if (!ndjson && !segment && config.getOutputFormat() != "json") {
+        spdlog::warn("Unknown output_format '{}', using json", config.getOutputFormat());
+    }
 
-    for (size_t i = 0; i < interfaces.size(); i++) {
-        spdlog::info("[{}] {}", i, interfaces[i]);
+    std::filesystem::path outputDir = config.getOutputDirectory();
+    std::filesystem::path outputName = config.getOutputFile();
+    if (ndjson && outputName.extension() == ".json") {
+        outputName.replace_extension(".ndjson");
     }
+    if (segment && outputName.extension() == ".json") {
+        outputName.replace_extension(".rwseg");
+    }
+    std::filesystem::path outputFile = outputDir / outputName;
 
-    size_t choice;
-    auto configInterface = config.getInterfaceIndex();
+    if (config.isFanoutEnabled()) {
+        // Every process in a fanout group writes its own segment; rewind-merge
+        // stitches them back together
+        outputFile = outputDir / (outputName.stem().string() + ".member-" +
+            std::to_string(config.getFanout().memberIndex) + outputName.extension().string());
+    }
 
-    if (configInterface.has_value()) {
-        choice = configInterface.value();
-        spdlog::info("Using interface {} from config", choice);
+    // The segment format writes a series of files named after this one
+    std::string outputDescription = std::filesystem::absolute(outputFile).string();
+    if (segment) {
+        outputDescription = (std::filesystem::absolute(outputDir) /
+            (outputFile.stem().string() + ".<start time>" + outputFile.extension().string())).string();
+    }
+
+    // Sessions are written out as they close, not at exit
+    std::shared_ptr<rwd::SessionSink> sink;
+    if (ndjson) {
+        const rwd::NdjsonConfig& ndjsonConfig = config.getNdjson();
+        rwd::NdjsonOptions ndjsonOptions;
+        ndjsonOptions.flushBytes = ndjsonConfig.flushBytes;
+        ndjsonOptions.flushInterval = ndjsonConfig.flushIntervalMs / 1000.0;
+        ndjsonOptions.fsyncInterval = ndjsonConfig.fsyncIntervalMs / 1000.0;
+        if (ndjsonConfig.fsync == "flush") {
+            ndjsonOptions.fsync = rwd::FsyncPolicy::EveryFlush;
+        } else if (ndjsonConfig.fsync == "interval") {
+            ndjsonOptions.fsync = rwd::FsyncPolicy::Interval;
+        } else if (ndjsonConfig.fsync != "never") {
+            spdlog::warn("Unknown ndjson fsync policy '{}', using never", ndjsonConfig.fsync);
+        }
+
+        auto ndjsonSink = std::make_shared<rwd::NdjsonFileSink>(outputFile.string(), bodyOptions, ndjsonOptions);
+        if (!ndjsonSink->open()) {
+            return 1;
+        }
+        sink = ndjsonSink;
+    } else if (segment) {
+        rwd::SegmentOptions segmentOptions;
+        segmentOptions.blockBytes = config.getSegment().blockBytes;
+        segmentOptions.flushInterval = config.getSegment().flushIntervalMs / 1000.0;
+        segmentOptions.rotateBytes = config.getSegment().rotateBytes;
+        segmentOptions.rotateInterval = config.getSegment().rotateIntervalSeconds;
+        segmentOptions.maxAge = config.getSegment().maxAgeHours * 3600.0;
+        segmentOptions.maxTotalBytes = config.getSegment().maxTotalBytes;
+
+        auto segmentSink = std::make_shared<rwd::SegmentFileSink>(outputFile.string(), bodyOptions, segmentOptions);
+        if (!segmentSink->open()) {
+            return 1;
+        }
+        sink = segmentSink;
     } else {
-        std::cout << "\nWhich interface? (enter number): ";
-        std::cin >> choice;
+        auto jsonSink = std::make_shared<rwd::JsonFileSink>(outputFile.string(), bodyOptions);
+        if (!jsonSink->open()) {
+            return 1;
+        }
+        sink = jsonSink;
+    }
+    sessionManager.setSink(sink);
+    spdlog::info("Writing sessions to {}", outputDescription);
+
+    if (metricsServer) {
+        sessionManager.setClosedCallback([&metricsServer](const rwd::Session& session) {
+            metricsServer->incrementSessionsClosed();
+            metricsServer->recordSessionDuration(session.getDuration());
+            metricsServer->recordSessionArenaBytes(session.getArena().getReservedBytes());
+        });
+    }
+
+    bool offline = !inputFile.empty();
+    std::vector<size_t> choices;
+
+    if (!offline) {
+        auto interfaces = rwd::Capturer::getAvailableInterfaces();
+        spdlog::info("Found {} network interfaces", interfaces.size());
+
+        for (size_t i = 0; i < interfaces.size(); i++) {
+            spdlog::info("[{}] {}", i, interfaces[i]);
+        }
+
+        auto configInterface = config.getInterfaceIndex();
+
+        if (config.isMultiInterface()) {
+            for (size_t index : config.getInterfaceIndexes()) {
+                if (std::find(choices.begin(), choices.end(), index) == choices.end()) {
+                    choices.push_back(index);
+                }
+            }
+            spdlog::info("Using {} interfaces from config", choices.size());
+        } else if (configInterface.has_value()) {
+            choices.push_back(configInterface.value());
+            spdlog::info("Using interface {} from config", choices.front());
+        } else {
+            size_t choice;
+            std::cout << "\nWhich interface? (enter number): ";
+            std::cin >> choice;
+            choices.push_back(choice);
+        }
     }
 
-    if (!capturer.open(choice)) {
-        spdlog::error("Failed to open interface!");
+    std::string bpfFilter = config.getBPFFilter();
+    if (!rwd::Capturer::isValidFilter(bpfFilter)) {
+        spdlog::error("Invalid BPF filter: {}", bpfFilter);
         return 1;
     }
 
+    bool useRing = config.getBackend() == "af_packet";
+    if (useRing && !rwd::PacketRing::isSupported()) {
+        spdlog::error("The af_packet capture backend is only supported on Linux");
+        return 1;
+    }
+    if (!useRing && config.getBackend() != "pcap") {
+        spdlog::error("Unknown capture backend: {}", config.getBackend());
+        return 1;
+    }
+    if (config.isFanoutEnabled() && !useRing && !offline) {
+        spdlog::error("capture.fanout requires the af_packet capture backend");
+        return 1;
+    }
+
+    // One capturer (and capture thread) per device, all feeding the
+    // same SessionManager
+    std::vector<std::unique_ptr<rwd::Capturer>> capturers;
+
+    if (offline) {
+        auto capturer = std::make_unique<rwd::Capturer>(config.getWorkerThreads(), bodyLimits, flowTimeouts);
+        if (!capturer->openFile(inputFile, replaySpeed)) {
+            return 1;
+        }
+        if (!capturer->setFilter(bpfFilter)) {
+            return 1;
+        }
+        capturers.push_back(std::move(capturer));
+    }
+
+    for (size_t choice : choices) {
+        auto capturer = std::make_unique<rwd::Capturer>(config.getWorkerThreads(), bodyLimits, flowTimeouts);
+        bool opened = useRing
+            ? capturer->openRing(choice, config.getRing())
+            : capturer->open(choice);
+        if (!opened) {
+            spdlog::error("Failed to open interface {}!", choice);
+            return 1;
+        }
+        if (!capturer->setFilter(bpfFilter)) {
+            return 1;
+        }
+        if (config.isFanoutEnabled() && !capturer->joinFanout(config.getFanout().groupId.value())) {
+            return 1;
+        }
+        capturers.push_back(std::move(capturer));
+    }
+
+    auto totalPackets = [&capturers]() {
+        int total = 0;
+        for (const auto& capturer : capturers) total += capturer->getPacketCount();
+        return total;
+    };
+    auto totalHttpMessages = [&capturers]() {
+        int total = 0;
+        for (const auto& capturer : capturers) total += capturer->getHttpMessageCount();
+        return total;
+    };
+    auto totalDroppedPackets = [&capturers]() {
+        int total = 0;
+        for (const auto& capturer : capturers) total += capturer->getDroppedPacketCount();
+        return total;
+    };
+
     auto onHttpMessage = [&sessionManager, &metricsServer](
-        const rwd::HttpMessage& msg,
-        const std::string& clientIp,
-        int clientPort,
-        const std::string& serverIp,
-        int serverPort,
-        bool isRequest)
+        size_t sourceId,
+        rwd::HttpMessage&& msg,
+        const rwd::FlowKey& flow,
+        bool isRequest,
+        double timestamp)
         {
-            sessionManager.addMessage(msg, clientIp, clientPort, serverIp, serverPort, isRequest);
+            // Logged before the message is handed to its session. Per-message
+            // lines are debug only: every worker calls this for every message.
+            if (spdlog::should_log(spdlog::level::debug)) {
+                spdlog::debug("=== HTTP {} ===",
+                    isRequest ? "Request" : "Response"
+                );
+                spdlog::debug("Connection: {}", flow);
+                spdlog::debug("First line: {}", msg.getFirstLine());
 
-            if (metricsServer) {
                 if (isRequest) {
-                    metricsServer->incrementHttpRequests();
-                } else {
-                    metricsServer->incrementHttpResponses();
+                    std::string_view host = msg.getHeader(rwd::HeaderName::Host);
+                    if (!host.empty()) {
+                        spdlog::debug("Host: {}", host);
+                    }
+                }
+                else {
+                    std::string_view contentType = msg.getHeader(rwd::HeaderName::ContentType);
+                    if (!contentType.empty()) {
+                        spdlog::debug("Content-Type: {}", contentType);
+                    }
                 }
             }
 
-            spdlog::info("=== HTTP {} ===",
-                isRequest ? "Request" : "Response"
-            );
-            spdlog::info("Connection: {}:{} -> {}:{}",
-                clientIp, clientPort, serverIp, serverPort);
-            spdlog::info("First line: {}", msg.getFirstLine());
-
-            if (isRequest) {
-                std::string host = msg.getHeader("Host");
-                if (!host.empty()) {
-                    spdlog::info("Host: {}", host);
-                }
+            if (!sessionManager.addMessage(std::move(msg), flow, isRequest, timestamp, sourceId)) {
+                return;
             }
-            else {
-                std::string contentType = msg.getHeader("Content-Type");
-                if (!contentType.empty()) {
-                    spdlog::info("Content-Type: {}", contentType);
+
+            if (metricsServer) {
+                if (isRequest) {
+                    metricsServer->incrementHttpRequests();
+                } else {
+                    metricsServer->incrementHttpResponses();
                 }
             }
         };
 
     spdlog::info("Starting capture...");
-    spdlog::info("Packet limit: {}", config.getPacketLimit());
-    spdlog::info("Timeout: {} seconds", config.getTimeoutSeconds());
+    if (offline) {
+        spdlog::info("Reading until end of file; packet limit and timeout are ignored");
+    } else {
+        spdlog::info("Packet limit: {}", config.getPacketLimit());
+        spdlog::info("Timeout: {} seconds", config.getTimeoutSeconds());
+    }
 
-    if (!capturer.startCapture(onHttpMessage))
-    {
-        spdlog::error("Failed to start capture!");
-        return 1;
+    for (size_t i = 0; i < capturers.size(); i++) {
+        auto callback = [i, &onHttpMessage](
+            rwd::HttpMessage&& msg,
+            const rwd::FlowKey& flow,
+            bool isRequest,
+            double timestamp)
+            {
+                onHttpMessage(i, std::move(msg), flow, isRequest, timestamp);
+            };
+        auto onFlowEnd = [i, &sessionManager](const rwd::FlowKey& flow, double lastTimestamp)
+            {
+                sessionManager.endSession(flow, i, lastTimestamp);
+            };
+
+        if (!capturers[i]->startCapture(callback, onFlowEnd))
+        {
+            spdlog::error("Failed to start capture!");
+            return 1;
+        }
     }
 
     auto startTime = std::chrono::steady_clock::now();
     int packetLimit = config.getPacketLimit();
     int timeoutSeconds = config.getTimeoutSeconds();
     int lastPacketCount = 0;
+    int lastDroppedCount = 0;
 
     while (true) {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        sink->poll();
 
         if (metricsServer) {
-            int currentPacketCount = capturer.getPacketCount();
+            int currentPacketCount = totalPackets();
             int newPackets = currentPacketCount - lastPacketCount;
             for (int i = 0; i < newPackets; i++) {
                 metricsServer->incrementPacketsProcessed();
             }
             lastPacketCount = currentPacketCount;
 
+            int currentDroppedCount = totalDroppedPackets();
+            for (int i = lastDroppedCount; i < currentDroppedCount; i++) {
+                metricsServer->incrementDroppedPackets();
+            }
+            lastDroppedCount = currentDroppedCount;
+
             metricsServer->setActiveSessions(sessionManager.getSessionCount());
+            metricsServer->setSessionArenaBytes(rwd::SessionArena::getTotalReservedBytes());
+
+            rwd::CaptureStats kernelStats;
+            for (const auto& capturer : capturers) {
+                auto stats = capturer->getCaptureStats();
+                kernelStats.packetsReceived += stats.packetsReceived;
+                kernelStats.packetsDropped += stats.packetsDropped;
+                kernelStats.packetsDroppedByInterface += stats.packetsDroppedByInterface;
+            }
+            metricsServer->setKernelPacketStats(
+                kernelStats.packetsReceived,
+                kernelStats.packetsDropped,
+                kernelStats.packetsDroppedByInterface);
+
+            rwd::PayloadBuffer::PoolStats poolStats = rwd::PayloadBuffer::getPoolStats();
+            metricsServer->setPayloadPoolStats(
+                poolStats.hits, poolStats.misses, poolStats.discarded, poolStats.pooled);
+        }
+
+        if (offline) {
+            if (capturers.front()->isFinished()) {
+                spdlog::info("End of capture file reached");
+                break;
+            }
+            continue;
         }
 
-        if (packetLimit > 0 && capturer.getHttpMessageCount() >= packetLimit) {
+        if (packetLimit > 0 && totalHttpMessages() >= packetLimit) {
             spdlog::info("Packet limit reached");
             break;
         }
@@ -175,85 +428,54 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    capturer.stopCapture();
-    spdlog::info("Capture complete!");
-    spdlog::info("Total packets: {}", capturer.getPacketCount());
-    spdlog::info("HTTP messages: {}", capturer.getHttpMessageCount());
+    for (auto& capturer : capturers) {
+        capturer->stopCapture();
+    }
+    double captureSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
 
+    spdlog::info("Capture complete!");
+    spdlog::info("Total packets: {}", totalPackets());
+    spdlog::info("HTTP messages: {}", totalHttpMessages());
+    if (captureSeconds > 0.0) {
+        spdlog::info("Throughput: {:.0f} packets/s, {:.0f} messages/s over {:.3f}s",
+            totalPackets() / captureSeconds,
+            totalHttpMessages() / captureSeconds,
+            captureSeconds);
+    }
+    if (capturers.size() > 1) {
+        spdlog::info("Duplicate messages dropped: {}", sessionManager.getDuplicateMessageCount());
+    }
+    size_t expiredFlows = 0;
+    for (const auto& capturer : capturers) expiredFlows += capturer->getExpiredFlowCount();
+    spdlog::info("Idle flows expired: {}", expiredFlows);
+    spdlog::info("Session arena peak: {} KB", rwd::SessionArena::getPeakReservedBytes() / 1024);
+    rwd::PayloadBuffer::PoolStats poolStats = rwd::PayloadBuffer::getPoolStats();
+    spdlog::info("Payload buffers: {} reused, {} allocated, {} freed",
+        poolStats.hits, poolStats.misses, poolStats.discarded);
+
+    // Whatever is still open at exit is written out now
     sessionManager.closeAllSessions();
-    spdlog::info("Sessions tracked: {}", sessionManager.getSessionCount());
-
+    sink->close();
     if (metricsServer) {
-        auto sessions = sessionManager.getAllSessions();
-        for (const auto& session : sessions) {
-            metricsServer->incrementSessionsClosed();
-            metricsServer->recordSessionDuration(session->getDuration());
-        }
         metricsServer->setActiveSessions(0);
+        metricsServer->setSessionArenaBytes(0);
     }
 
-    spdlog::info("Converting {} sessions to JSON...", sessionManager.getSessionCount());
-
-    nlohmann::json output;
-
-    try
-    {
-        output = sessionManager.toJson();
-        spdlog::info("Conversion complete!");
-    }
-    catch (const std::exception& e)
-    {
-        spdlog::error("Failed to convert sessions to JSON: {}", e.what());
-        return 1;
-    }
-
-    std::filesystem::path outputDir = config.getOutputDirectory();
-    std::filesystem::path outputFile = outputDir / config.getOutputFile();
-
-    try {
-        std::filesystem::create_directories(outputDir);
-
-        std::ofstream outFile(outputFile);
-        if (outFile.is_open())
-        {
-            outFile << output.dump(2);
-            outFile.close();
-
-            std::filesystem::path fullPath = std::filesystem::absolute(outputFile);
-            spdlog::info("Saved {} sessions to:", sessionManager.getSessionCount());
-            spdlog::info("  {}", fullPath.string());
-        }
-        else
-        {
-            spdlog::error("Failed to open {}", outputFile.string());
-        }
-    }
-    catch (const std::exception& e)
-    {
-        spdlog::error("Failed to write JSON file: {}", e.what());
-    }
+    spdlog::info("Saved {} sessions to:", sink->getSessionCount());
+    spdlog::info("  {}", outputDescription);
 
     std::cout << "\n=== CAPTURE SUMMARY ===" << std::endl;
-    std::cout << "Sessions: " << sessionManager.getSessionCount() << std::endl;
-    std::cout << "Packets:  " << capturer.getPacketCount() << std::endl;
-    std::cout << "Messages: " << capturer.getHttpMessageCount() << std::endl;
-
-    if (sessionManager.getSessionCount() > 0)
-    {
-        auto sessions = sessionManager.getAllSessions();
-        auto firstSession = sessions[0];
-
-        std::cout << "\n--- Example Session ---" << std::endl;
-        std::cout << "ID: " << firstSession->getSessionId() << std::endl;
-        std::cout << "Transactions: " << firstSession->getTransactionCount() << std::endl;
-        std::cout << "Duration: " << std::fixed << std::setprecision(3)
-            << firstSession->getDuration() << "s" << std::endl;
-        std::cout << "----------------------\n" << std::endl;
+    std::cout << "Sessions: " << sessionManager.getClosedSessionCount() << std::endl;
+    std::cout << "Packets:  " << totalPackets() << std::endl;
+    std::cout << "Messages: " << totalHttpMessages() << std::endl;
+    std::cout << std::endl;
+
+    if (!offline) {
+        std::cout << "Press Enter to exit..." << std::endl;
+        std::cin.ignore();
+        std::cin.get();
     }
 
-    std::cout << "Press Enter to exit..." << std::endl;
-    std::cin.ignore();
-    std::cin.get();
-
     return 0;
 }
@@ -3,11 +3,31 @@
 
 namespace rwd {
 
+    namespace {
+        // Advances a counter mirroring a cumulative count sampled elsewhere
+        // by what is new since the last sample. A count that went backwards
+        // was reset at its source; everything since the reset is new.
+        void advanceCounter(prometheus::Counter* counter, uint64_t& last, uint64_t total)
+        {
+            uint64_t delta = total >= last ? total - last : total;
+            if (delta > 0) {
+                counter->Increment(static_cast<double>(delta));
+            }
+            last = total;
+        }
+    }
+
     MetricsServer::MetricsServer(int port, const std::string& endpoint)
         : port_(port)
         , endpoint_(endpoint)
         , exposer_(nullptr)
         , registry_(std::make_shared<prometheus::Registry>())
+        , lastKernelPacketsReceived_(0)
+        , lastKernelPacketsDropped_(0)
+        , lastKernelPacketsDroppedByInterface_(0)
+        , lastPayloadPoolHits_(0)
+        , lastPayloadPoolMisses_(0)
+        , lastPayloadPoolDiscarded_(0)
     {
         packetsFamily_ = &prometheus::BuildCounter()
             .Name("rewind_packets_total")
@@ -34,11 +54,36 @@ namespace rwd {
             .Help("Number of currently active sessions")
             .Register(*registry_);
 
+        kernelPacketsFamily_ = &prometheus::BuildCounter()
+            .Name("rewind_kernel_packets_total")
+            .Help("Packet counters reported by the kernel (pcap_stats) since capture start")
+            .Register(*registry_);
+
+        payloadPoolFamily_ = &prometheus::BuildCounter()
+            .Name("rewind_payload_pool_events_total")
+            .Help("Message buffer acquisitions served from the pool (hit) or allocated (miss), and buffers freed on release (discarded)")
+            .Register(*registry_);
+
+        payloadPoolIdleFamily_ = &prometheus::BuildGauge()
+            .Name("rewind_payload_pool_idle_buffers")
+            .Help("Message buffers kept in the pool for reuse")
+            .Register(*registry_);
+
         histogramFamily_ = &prometheus::BuildHistogram()
             .Name("rewind_operation_duration_seconds")
             .Help("Operation durations in seconds")
             .Register(*registry_);
 
+        arenaFamily_ = &prometheus::BuildGauge()
+            .Name("rewind_session_arena_bytes")
+            .Help("Arena memory reserved by open sessions")
+            .Register(*registry_);
+
+        arenaHistogramFamily_ = &prometheus::BuildHistogram()
+            .Name("rewind_session_arena_size_bytes")
+            .Help("Arena memory reserved by each session when it closed")
+            .Register(*registry_);
+
         packetsProcessed_ = &packetsFamily_->Add({{"type", "processed"}});
         httpMessages_ = &httpMessagesFamily_->Add({{"type", "all"}});
         httpRequests_ = &httpMessagesFamily_->Add({{"type", "requests"}});
@@ -48,6 +93,13 @@ namespace rwd {
         errors_ = &errorsFamily_->Add({{"type", "general"}});
         droppedPackets_ = &errorsFamily_->Add({{"type", "dropped_packets"}});
         activeSessions_ = &gaugeFamily_->Add({{"state", "active"}});
+        kernelPacketsReceived_ = &kernelPacketsFamily_->Add({{"type", "received"}});
+        kernelPacketsDropped_ = &kernelPacketsFamily_->Add({{"type", "dropped"}});
+        kernelPacketsDroppedByInterface_ = &kernelPacketsFamily_->Add({{"type", "if_dropped"}});
+        payloadPoolHits_ = &payloadPoolFamily_->Add({{"type", "hit"}});
+        payloadPoolMisses_ = &payloadPoolFamily_->Add({{"type", "miss"}});
+        payloadPoolDiscarded_ = &payloadPoolFamily_->Add({{"type", "discarded"}});
+        payloadPoolIdle_ = &payloadPoolIdleFamily_->Add({});
         captureLatency_ = &histogramFamily_->Add(
             {{"operation", "capture"}},
             prometheus::Histogram::BucketBoundaries{0.001, 0.01, 0.1, 1.0, 10.0}
@@ -56,6 +108,11 @@ namespace rwd {
             {{"operation", "session"}},
             prometheus::Histogram::BucketBoundaries{0.1, 1.0, 10.0, 60.0, 300.0}
         );
+        arenaReserved_ = &arenaFamily_->Add({{"type", "reserved"}});
+        sessionArena_ = &arenaHistogramFamily_->Add(
+            {{"type", "reserved"}},
+            prometheus::Histogram::BucketBoundaries{1024, 4096, 16384, 65536, 262144, 1048576, 4194304}
+        );
     }
 
     MetricsServer::~MetricsServer() {
@@ -120,6 +177,20 @@ namespace rwd {
         droppedPackets_->Increment();
     }
 
+    void MetricsServer::setKernelPacketStats(uint64_t received, uint64_t dropped, uint64_t droppedByInterface) {
+        advanceCounter(kernelPacketsReceived_, lastKernelPacketsReceived_, received);
+        advanceCounter(kernelPacketsDropped_, lastKernelPacketsDropped_, dropped);
+        advanceCounter(kernelPacketsDroppedByInterface_, lastKernelPacketsDroppedByInterface_, droppedByInterface);
+    }
+
+    void MetricsServer::setPayloadPoolStats(uint64_t hits, uint64_t misses, uint64_t discarded, uint64_t pooled) {
+        // The pool counts since start
+        advanceCounter(payloadPoolHits_, lastPayloadPoolHits_, hits);
+        advanceCounter(payloadPoolMisses_, lastPayloadPoolMisses_, misses);
+        advanceCounter(payloadPoolDiscarded_, lastPayloadPoolDiscarded_, discarded);
+        payloadPoolIdle_->Set(static_cast<double>(pooled));
+    }
+
     void MetricsServer::recordCaptureLatency(double seconds) {
         captureLatency_->Observe(seconds);
     }
@@ -127,4 +198,12 @@ namespace rwd {
     void MetricsServer::recordSessionDuration(double seconds) {
         sessionDuration_->Observe(seconds);
     }
+
+    void MetricsServer::recordSessionArenaBytes(size_t bytes) {
+        sessionArena_->Observe(static_cast<double>(bytes));
+    }
+
+    void MetricsServer::setSessionArenaBytes(size_t bytes) {
+        arenaReserved_->Set(static_cast<double>(bytes));
+    }
 }
@@ -0,0 +1,106 @@
+#include "rewind/output/JsonFileSink.h"
+#include "rewind/output/JsonWriter.h"
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+namespace rwd {
+
+    JsonFileSink::JsonFileSink(const std::string& path, const BodyOptions& bodyOptions)
+        : path_(path)
+        , bodyOptions_(bodyOptions)
+        , trailerPos_(0)
+        , sessionCount_(0)
+    {
+    }
+
+    JsonFileSink::~JsonFileSink()
+    {
+        close();
+    }
+
+    bool JsonFileSink::open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        try {
+            std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+            if (!parent.empty()) {
+                std::filesystem::create_directories(parent);
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Failed to create output directory for {}: {}", path_, e.what());
+            return false;
+        }
+
+        out_.open(path_, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out_.is_open()) {
+            spdlog::error("Failed to open {}", path_);
+            return false;
+        }
+
+        out_ << "{\"sessions\":[\n";
+        trailerPos_ = out_.tellp();
+        writeTrailer();
+        return true;
+    }
+
+    bool JsonFileSink::write(const Session& session)
+    {
+        // Rendered before taking the lock into a per-thread buffer that is
+        // reused across sessions; only the file append is serialised.
+        // Bytes that are not UTF-8 (e.g. in a URI) are replaced rather than
+        // failing the whole session.
+        thread_local std::string rendered;
+        rendered.clear();
+        try {
+            JsonWriter writer(rendered);
+            session.writeJson(writer, bodyOptions_);
+        }
+        catch (const std::exception& e) {
+            spdlog::warn("Failed to convert session {} to JSON: {}", session.getFlowKey(), e.what());
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!out_.is_open()) {
+            return false;
+        }
+
+        out_.seekp(trailerPos_);
+        if (sessionCount_ > 0) {
+            out_ << ",\n";
+        }
+        out_ << rendered << '\n';
+        trailerPos_ = out_.tellp();
+        sessionCount_++;
+        writeTrailer();
+
+        if (!out_) {
+            spdlog::error("Failed to write session to {}", path_);
+            return false;
+        }
+        return true;
+    }
+
+    void JsonFileSink::close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (out_.is_open()) {
+            out_.close();
+        }
+    }
+
+    size_t JsonFileSink::getSessionCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessionCount_;
+    }
+
+    void JsonFileSink::writeTrailer()
+    {
+        out_ << "],\"sessionCount\":" << sessionCount_ << "}\n";
+        out_.flush();
+    }
+
+}
@@ -0,0 +1,214 @@
+#include "rewind/output/JsonWriter.h"
+#include "rewind/parsers/Utf8Validator.h"
+#include <array>
+#include <charconv>
+#include <cmath>
+
+namespace rwd {
+
+    namespace {
+        // Bytes that cannot be copied into a JSON string as they are
+        constexpr std::array<bool, 256> kNeedsEscape = [] {
+            std::array<bool, 256> table{};
+            for (int c = 0; c < 0x20; c++) {
+                table[c] = true;
+            }
+            table['"'] = true;
+            table['\\'] = true;
+            return table;
+        }();
+
+        constexpr std::string_view kReplacement = "\xEF\xBF\xBD";
+
+        // Length of the well-formed UTF-8 sequence at text[i] (RFC 3629), or
+        // 0 if there is none. In that case `invalid` is set to the length of
+        // the broken prefix to replace with one U+FFFD (the lead byte plus any
+        // continuation bytes that were still valid), as nlohmann::json does.
+        size_t sequenceLength(std::string_view text, size_t i, size_t& invalid)
+        {
+            auto byte = [&text](size_t at) { return static_cast<unsigned char>(text[at]); };
+
+            unsigned char lead = byte(i);
+            size_t length = 0;
+            unsigned char low = 0x80;
+            unsigned char high = 0xBF;
+            if (lead >= 0xC2 && lead <= 0xDF) {
+                length = 2;
+            }
+            else if (lead >= 0xE0 && lead <= 0xEF) {
+                length = 3;
+                low = lead == 0xE0 ? 0xA0 : 0x80;
+                high = lead == 0xED ? 0x9F : 0xBF;
+            }
+            else if (lead >= 0xF0 && lead <= 0xF4) {
+                length = 4;
+                low = lead == 0xF0 ? 0x90 : 0x80;
+                high = lead == 0xF4 ? 0x8F : 0xBF;
+            }
+
+            // Only the first continuation byte has a narrowed range
+            size_t valid = 1;
+            while (valid < length && i + valid < text.size() &&
+                byte(i + valid) >= low && byte(i + valid) <= high) {
+                valid++;
+                low = 0x80;
+                high = 0xBF;
+            }
+
+            if (length != 0 && valid == length) {
+                return length;
+            }
+            invalid = valid;
+            return 0;
+        }
+
+        void appendEscaped(std::string& out, unsigned char c)
+        {
+            switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                static constexpr char kHex[] = "0123456789abcdef";
+                char escaped[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+                out.append(escaped, sizeof(escaped));
+                break;
+            }
+            }
+        }
+    }
+
+    void JsonWriter::open(char bracket)
+    {
+        separate();
+        out_ += bracket;
+        depth_++;
+        if (depth_ < 64) {
+            hasElements_ &= ~(uint64_t(1) << depth_);
+        }
+    }
+
+    void JsonWriter::close(char bracket)
+    {
+        out_ += bracket;
+        depth_--;
+    }
+
+    void JsonWriter::separate()
+    {
+        if (afterKey_) {
+            afterKey_ = false;
+            return;
+        }
+        if (depth_ == 0 || depth_ >= 64) {
+            return;
+        }
+
+        uint64_t bit = uint64_t(1) << depth_;
+        if (hasElements_ & bit) {
+            out_ += ',';
+        }
+        hasElements_ |= bit;
+    }
+
+    void JsonWriter::key(std::string_view name)
+    {
+        separate();
+        writeString(name);
+        out_ += ':';
+        afterKey_ = true;
+    }
+
+    void JsonWriter::value(std::string_view text)
+    {
+        separate();
+        writeString(text);
+    }
+
+    void JsonWriter::value(bool flag)
+    {
+        separate();
+        out_ += flag ? "true" : "false";
+    }
+
+    void JsonWriter::value(double number)
+    {
+        separate();
+        if (!std::isfinite(number)) {
+            out_ += "null";
+            return;
+        }
+
+        // Shortest round-trip form; whole numbers keep a ".0" so they read
+        // back as floating point, as nlohmann::json writes them
+        char buffer[32];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        std::string_view text(buffer, static_cast<size_t>(end - buffer));
+        out_ += text;
+        if (text.find_first_of(".eE") == std::string_view::npos) {
+            out_ += ".0";
+        }
+    }
+
+    void JsonWriter::null()
+    {
+        separate();
+        out_ += "null";
+    }
+
+    void JsonWriter::writeInteger(int64_t number)
+    {
+        char buffer[24];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        out_.append(buffer, end);
+    }
+
+    void JsonWriter::writeInteger(uint64_t number)
+    {
+        char buffer[24];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        out_.append(buffer, end);
+    }
+
+    void JsonWriter::writeString(std::string_view text)
+    {
+        out_ += '"';
+
+        // Text already known to be UTF-8 only needs its ASCII specials escaped
+        bool valid = Utf8Validator::validate(text);
+
+        size_t runStart = 0;
+        size_t i = 0;
+        while (i < text.size()) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (kNeedsEscape[c]) {
+                out_.append(text.data() + runStart, i - runStart);
+                appendEscaped(out_, c);
+                runStart = ++i;
+            }
+            else if (c >= 0x80 && !valid) {
+                size_t invalid = 0;
+                size_t length = sequenceLength(text, i, invalid);
+                if (length == 0) {
+                    out_.append(text.data() + runStart, i - runStart);
+                    out_ += kReplacement;
+                    i += invalid;
+                    runStart = i;
+                } else {
+                    i += length;
+                }
+            }
+            else {
+                i++;
+            }
+        }
+        out_.append(text.data() + runStart, text.size() - runStart);
+
+        out_ += '"';
+    }
+
+}
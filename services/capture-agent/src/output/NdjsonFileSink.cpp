@@ -0,0 +1,167 @@
+#include "rewind/output/NdjsonFileSink.h"
+#include "rewind/output/JsonWriter.h"
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace rwd {
+
+    NdjsonFileSink::NdjsonFileSink(const std::string& path, const BodyOptions& bodyOptions,
+        const NdjsonOptions& options)
+        : path_(path)
+        , bodyOptions_(bodyOptions)
+        , options_(options)
+        , file_(nullptr)
+        , unsynced_(false)
+        , sessionCount_(0)
+    {
+    }
+
+    NdjsonFileSink::~NdjsonFileSink()
+    {
+        close();
+    }
+
+    bool NdjsonFileSink::open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        try {
+            std::filesystem::path parent = std::filesystem::path(path_).parent_path();
+            if (!parent.empty()) {
+                std::filesystem::create_directories(parent);
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Failed to create output directory for {}: {}", path_, e.what());
+            return false;
+        }
+
+        // Appending keeps offsets held by readers valid across restarts
+        file_ = std::fopen(path_.c_str(), "ab");
+        if (!file_) {
+            spdlog::error("Failed to open {}", path_);
+            return false;
+        }
+
+        batch_.reserve(options_.flushBytes + 4096);
+        lastSync_ = Clock::now();
+        return true;
+    }
+
+    bool NdjsonFileSink::write(const Session& session)
+    {
+        // Rendered before taking the lock, as in JsonFileSink
+        thread_local std::string rendered;
+        rendered.clear();
+        try {
+            JsonWriter writer(rendered);
+            session.writeJson(writer, bodyOptions_);
+        }
+        catch (const std::exception& e) {
+            spdlog::warn("Failed to convert session {} to JSON: {}", session.getFlowKey(), e.what());
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) {
+            return false;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (batch_.empty()) {
+            batchStart_ = now;
+        }
+        batch_ += rendered;
+        batch_ += '\n';
+        sessionCount_++;
+
+        if (batch_.size() >= options_.flushBytes ||
+            std::chrono::duration<double>(now - batchStart_).count() >= options_.flushInterval) {
+            return flushLocked();
+        }
+        return true;
+    }
+
+    void NdjsonFileSink::poll()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) {
+            return;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (!batch_.empty() &&
+            std::chrono::duration<double>(now - batchStart_).count() >= options_.flushInterval) {
+            flushLocked();
+        }
+
+        if (options_.fsync == FsyncPolicy::Interval && unsynced_ &&
+            std::chrono::duration<double>(now - lastSync_).count() >= options_.fsyncInterval) {
+            syncLocked();
+        }
+    }
+
+    void NdjsonFileSink::close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) {
+            return;
+        }
+
+        flushLocked();
+        if (options_.fsync != FsyncPolicy::Never && unsynced_) {
+            syncLocked();
+        }
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    size_t NdjsonFileSink::getSessionCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessionCount_;
+    }
+
+    bool NdjsonFileSink::flushLocked()
+    {
+        if (batch_.empty()) {
+            return true;
+        }
+
+        bool ok = std::fwrite(batch_.data(), 1, batch_.size(), file_) == batch_.size() &&
+            std::fflush(file_) == 0;
+        batch_.clear();
+        unsynced_ = true;
+
+        if (!ok) {
+            spdlog::error("Failed to write sessions to {}", path_);
+            return false;
+        }
+
+        if (options_.fsync == FsyncPolicy::EveryFlush) {
+            syncLocked();
+        }
+        return true;
+    }
+
+    void NdjsonFileSink::syncLocked()
+    {
+#ifdef _WIN32
+        int result = _commit(_fileno(file_));
+#else
+        int result = fsync(fileno(file_));
+#endif
+        if (result != 0) {
+            spdlog::warn("Failed to sync {} to disk", path_);
+        }
+        lastSync_ = Clock::now();
+        unsynced_ = false;
+    }
+
+}
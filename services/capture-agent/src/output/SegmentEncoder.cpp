@@ -0,0 +1,246 @@
+#include "rewind/output/SegmentEncoder.h"
+
+namespace rwd {
+
+    static_assert(static_cast<uint8_t>(HttpMessage::BodyOutput::Kind::None) == kSegmentBodyNone &&
+        static_cast<uint8_t>(HttpMessage::BodyOutput::Kind::Text) == kSegmentBodyText &&
+        static_cast<uint8_t>(HttpMessage::BodyOutput::Kind::Preview) == kSegmentBodyPreview &&
+        static_cast<uint8_t>(HttpMessage::BodyOutput::Kind::Type) == kSegmentBodyType);
+
+    void SegmentDictionary::encode(std::string_view value, std::string& out)
+    {
+        auto it = entries_.find(value);
+        if (it != entries_.end()) {
+            segment::putVarint(out, static_cast<uint64_t>(it->second) + 1);
+            return;
+        }
+
+        out += '\0';
+        segment::putVarint(out, value.size());
+        out += value;
+        entries_.emplace(std::string(value), static_cast<uint32_t>(entries_.size()));
+    }
+
+    void SegmentSession::render(const Session& source, const BodyOptions& options)
+    {
+        session = &source;
+        messageCount = 0;
+
+        // Sized before anything is rendered: a filled-in body must not move
+        const auto& transactions = source.getTransactions();
+        if (messages.size() < transactions.size() * 2) {
+            messages.resize(transactions.size() * 2);
+        }
+
+        auto renderMessage = [this, &options](const HttpMessage& message) {
+            Message& rendered = messages[messageCount++];
+            rendered.message = &message;
+            rendered.headers.clear();
+            message.collectOutputHeaders(rendered.headers);
+
+            rendered.body.kind = HttpMessage::BodyOutput::Kind::None;
+            rendered.body.text = std::string_view();
+            rendered.body.decoded = false;
+            rendered.body.truncated = false;
+            message.renderBody(options, rendered.body);
+        };
+
+        for (const auto& transaction : transactions) {
+            if (transaction.hasRequest()) {
+                renderMessage(transaction.getRequest());
+            }
+            if (transaction.hasResponse()) {
+                renderMessage(transaction.getResponse());
+            }
+        }
+    }
+
+    SegmentBlockEncoder::SegmentBlockEncoder()
+    {
+        clear();
+    }
+
+    void SegmentBlockEncoder::add(const SegmentSession& rendered)
+    {
+        const Session& session = *rendered.session;
+        const FlowKey& flow = session.getFlowKey();
+
+        std::string& flows = column(SegmentColumn::Flows);
+        size_t addressLength = flow.ipVersion == 6 ? 16 : 4;
+        flows += static_cast<char>(flow.ipVersion);
+        flows.append(reinterpret_cast<const char*>(flow.clientAddress.data()), addressLength);
+        flows.append(reinterpret_cast<const char*>(flow.serverAddress.data()), addressLength);
+        segment::putVarint(flows, flow.clientPort);
+        segment::putVarint(flows, flow.serverPort);
+
+        int64_t start = segment::toMicros(session.getStartTime());
+        int64_t end = segment::toMicros(session.getEndTime());
+        size_t emitted = 0;
+        for (const auto& transaction : session.getTransactions()) {
+            if (transaction.hasRequest() || transaction.hasResponse()) {
+                emitted++;
+            }
+        }
+
+        std::string& sessionTimes = column(SegmentColumn::SessionTimes);
+        segment::putSigned(sessionTimes, start - previousStart_);
+        segment::putSigned(sessionTimes, end - start);
+        segment::putVarint(sessionTimes, session.getTransactionCount());
+        segment::putVarint(sessionTimes, emitted);
+        previousStart_ = start;
+
+        // An unset (zero) start would make the block match every time
+        // range; such a session is placed at its end instead
+        int64_t rangeStart = start != 0 ? start : end;
+        if (sessionCount_ == 0 || rangeStart < firstStart_) {
+            firstStart_ = rangeStart;
+        }
+        if (sessionCount_ == 0 || end > lastEnd_) {
+            lastEnd_ = end;
+        }
+        sessionCount_++;
+
+        // The response time is kept as the duration after the request, which
+        // is what a latency scan reads
+        std::string& transactionTimes = column(SegmentColumn::TransactionTimes);
+        size_t message = 0;
+        for (const auto& transaction : session.getTransactions()) {
+            uint8_t presence = (transaction.hasRequest() ? kSegmentHasRequest : 0) |
+                (transaction.hasResponse() ? kSegmentHasResponse : 0);
+            if (presence == 0) {
+                continue;
+            }
+
+            transactionTimes += static_cast<char>(presence);
+            int64_t requestTime = segment::toMicros(transaction.getRequestTime());
+            int64_t responseTime = segment::toMicros(transaction.getResponseTime());
+            if (transaction.hasRequest()) {
+                segment::putSigned(transactionTimes, requestTime - start);
+                addMessage(rendered.messages[message++]);
+            }
+            if (transaction.isComplete()) {
+                segment::putSigned(transactionTimes, responseTime - requestTime);
+            } else if (transaction.hasResponse()) {
+                segment::putSigned(transactionTimes, responseTime - start);
+            }
+            if (transaction.hasResponse()) {
+                addMessage(rendered.messages[message++]);
+            }
+        }
+    }
+
+    void SegmentBlockEncoder::addMessage(const SegmentSession::Message& rendered)
+    {
+        const HttpMessage& message = *rendered.message;
+        bool isRequest = message.getType() == HttpMessage::Type::Request;
+
+        std::string& heads = column(SegmentColumn::MessageHeads);
+        heads += static_cast<char>(isRequest ? 0 : 1);
+        if (!isRequest) {
+            segment::putSigned(heads, message.getStatusCode());
+        }
+        segment::putVarint(heads, message.getLength());
+
+        if (isRequest) {
+            methods_.encode(message.getMethod(), column(SegmentColumn::Methods));
+            uris_.encode(message.getUri(), column(SegmentColumn::Uris));
+        } else {
+            statusMessages_.encode(message.getStatusMessage(), column(SegmentColumn::StatusMessages));
+        }
+        versions_.encode(message.getVersion(), column(SegmentColumn::Versions));
+
+        std::string& names = column(SegmentColumn::HeaderNames);
+        std::string& values = column(SegmentColumn::HeaderValues);
+        segment::putVarint(names, rendered.headers.size());
+        for (const auto& [name, value] : rendered.headers) {
+            headerNames_.encode(name, names);
+            headerValues_.encode(value, values);
+        }
+
+        const HttpMessage::BodyOutput& body = rendered.body;
+        uint8_t flags = static_cast<uint8_t>(body.kind);
+        if (body.kind != HttpMessage::BodyOutput::Kind::None) {
+            flags |= (body.decoded ? kSegmentBodyDecoded : 0) |
+                (body.truncated ? kSegmentBodyTruncated : 0) |
+                (message.isBodyTruncated() ? kSegmentBodyCaptureCut : 0);
+        }
+
+        std::string& bodies = column(SegmentColumn::Bodies);
+        bodies += static_cast<char>(flags);
+        switch (body.kind) {
+        case HttpMessage::BodyOutput::Kind::None:
+            return;
+        case HttpMessage::BodyOutput::Kind::Text:
+        case HttpMessage::BodyOutput::Kind::Preview:
+            segment::putVarint(bodies, message.getBodyLength());
+            if (message.isBodyTruncated()) {
+                segment::putVarint(bodies, message.getBody().size());
+            }
+            segment::putVarint(bodies, body.text.size());
+            column(SegmentColumn::Blob) += body.text;
+            break;
+        case HttpMessage::BodyOutput::Kind::Type:
+            segment::putVarint(bodies, message.getBodyLength());
+            if (message.isBodyTruncated()) {
+                segment::putVarint(bodies, message.getBody().size());
+            }
+            bodyTypes_.encode(body.text, column(SegmentColumn::BodyTypes));
+            break;
+        }
+    }
+
+    size_t SegmentBlockEncoder::getBufferedBytes() const
+    {
+        size_t total = 0;
+        for (const auto& bytes : columns_) {
+            total += bytes.size();
+        }
+        return total;
+    }
+
+    void SegmentBlockEncoder::finish(std::string& out, SegmentBlockInfo& info)
+    {
+        size_t blockStart = out.size();
+        segment::putFixed32(out, kSegmentBlockMagic);
+        segment::putFixed32(out, sessionCount_);
+        segment::putFixed32(out, static_cast<uint32_t>(kSegmentColumnCount));
+
+        std::array<bool, kSegmentColumnCount> deflated{};
+        for (size_t i = 0; i < kSegmentColumnCount; i++) {
+            deflated[i] = segment::deflateColumn(columns_[i], deflated_[i]);
+            const std::string& stored = deflated[i] ? deflated_[i] : columns_[i];
+            segment::putFixed32(out, static_cast<uint32_t>(stored.size()));
+            segment::putFixed32(out, static_cast<uint32_t>(columns_[i].size()));
+        }
+        for (size_t i = 0; i < kSegmentColumnCount; i++) {
+            out += deflated[i] ? deflated_[i] : columns_[i];
+        }
+
+        info.length = static_cast<uint32_t>(out.size() - blockStart);
+        info.sessionCount = sessionCount_;
+        info.firstStart = firstStart_;
+        info.lastEnd = lastEnd_;
+
+        clear();
+    }
+
+    void SegmentBlockEncoder::clear()
+    {
+        for (auto& bytes : columns_) {
+            bytes.clear();
+        }
+        methods_.clear();
+        uris_.clear();
+        statusMessages_.clear();
+        versions_.clear();
+        headerNames_.clear();
+        headerValues_.clear();
+        bodyTypes_.clear();
+
+        sessionCount_ = 0;
+        previousStart_ = 0;
+        firstStart_ = 0;
+        lastEnd_ = 0;
+    }
+
+}
@@ -0,0 +1,345 @@
+#include "rewind/output/SegmentFileSink.h"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+namespace rwd {
+
+    namespace {
+        // Retention by age is also checked this often while no segment is
+        // being rotated
+        constexpr std::chrono::seconds kRetentionCheckInterval(60);
+
+        std::string utcStamp(std::chrono::system_clock::time_point time)
+        {
+            std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+            std::tm utc;
+#ifdef _WIN32
+            gmtime_s(&utc, &seconds);
+#else
+            gmtime_r(&seconds, &utc);
+#endif
+            char stamp[32];
+            std::strftime(stamp, sizeof(stamp), "%Y%m%dT%H%M%SZ", &utc);
+            return stamp;
+        }
+    }
+
+    SegmentFileSink::SegmentFileSink(const std::string& path, const BodyOptions& bodyOptions,
+        const SegmentOptions& options)
+        : bodyOptions_(bodyOptions)
+        , options_(options)
+        , file_(nullptr)
+        , offset_(0)
+        , bytesWritten_(0)
+        , sessionCount_(0)
+    {
+        std::filesystem::path series(path);
+        directory_ = series.parent_path().string();
+        stem_ = series.stem().string();
+        extension_ = series.has_extension() ? series.extension().string() : ".rwseg";
+    }
+
+    SegmentFileSink::~SegmentFileSink()
+    {
+        close();
+    }
+
+    bool SegmentFileSink::open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        try {
+            if (!directory_.empty()) {
+                std::filesystem::create_directories(directory_);
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Failed to create output directory {}: {}", directory_, e.what());
+            return false;
+        }
+
+        if (!openSegmentLocked()) {
+            return false;
+        }
+        applyRetentionLocked();
+        return true;
+    }
+
+    bool SegmentFileSink::write(const Session& session)
+    {
+        // Headers and bodies are rendered before taking the lock, as in
+        // JsonFileSink; only the column appends are serialised
+        thread_local SegmentSession rendered;
+        try {
+            rendered.render(session, bodyOptions_);
+        }
+        catch (const std::exception& e) {
+            spdlog::warn("Failed to render session {}: {}", session.getFlowKey(), e.what());
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) {
+            return false;
+        }
+
+        if (encoder_.getSessionCount() == 0) {
+            blockStart_ = Clock::now();
+        }
+        encoder_.add(rendered);
+        sessionCount_++;
+
+        if (encoder_.getBufferedBytes() >= options_.blockBytes && !flushLocked()) {
+            return false;
+        }
+        if (shouldRotateLocked(WallClock::now())) {
+            return rotateLocked();
+        }
+        return true;
+    }
+
+    void SegmentFileSink::poll()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) {
+            return;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (encoder_.getSessionCount() > 0 &&
+            std::chrono::duration<double>(now - blockStart_).count() >= options_.flushInterval) {
+            flushLocked();
+        }
+
+        if (shouldRotateLocked(WallClock::now())) {
+            rotateLocked();
+        }
+        else if (options_.maxAge > 0 && now - lastRetention_ >= kRetentionCheckInterval) {
+            applyRetentionLocked();
+        }
+    }
+
+    void SegmentFileSink::close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) {
+            return;
+        }
+
+        finishSegmentLocked();
+    }
+
+    std::string SegmentFileSink::getPath() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return path_;
+    }
+
+    size_t SegmentFileSink::getSessionCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessionCount_;
+    }
+
+    uint64_t SegmentFileSink::getBytesWritten() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytesWritten_;
+    }
+
+    bool SegmentFileSink::openSegmentLocked()
+    {
+        WallClock::time_point now = WallClock::now();
+        std::string stamp = utcStamp(now);
+
+        // Segments started within the same second get a counter
+        std::filesystem::path path;
+        std::error_code error;
+        for (int n = 0;; n++) {
+            std::string name = stem_ + "." + stamp + (n > 0 ? "-" + std::to_string(n) : "") + extension_;
+            path = std::filesystem::path(directory_) / name;
+            if (!std::filesystem::exists(path, error)) {
+                break;
+            }
+        }
+
+        path_ = path.string();
+        indexPath_ = segmentIndexPath(path_);
+        file_ = std::fopen(path_.c_str(), "wb");
+        if (!file_) {
+            spdlog::error("Failed to open {}", path_);
+            return false;
+        }
+
+        offset_ = 0;
+        index_ = SegmentIndex();
+        index_.segment = path.filename().string();
+
+        if (options_.rotateInterval > 0) {
+            // On multiples of the interval, so that segments line up with
+            // wall-clock windows (14:00, 14:05, ...)
+            std::chrono::seconds interval(options_.rotateInterval);
+            std::chrono::seconds elapsed = std::chrono::floor<std::chrono::seconds>(now.time_since_epoch());
+            rotateAt_ = WallClock::time_point(elapsed / interval * interval + interval);
+        }
+
+        if (!writeLocked(std::string(kSegmentMagic))) {
+            return false;
+        }
+        index_.bytes = offset_;
+        writeSegmentIndex(indexPath_, index_);
+        return true;
+    }
+
+    void SegmentFileSink::finishSegmentLocked()
+    {
+        flushLocked();
+
+        uint64_t footerOffset = offset_;
+        std::string footer;
+        segment::putFixed32(footer, static_cast<uint32_t>(index_.blocks.size()));
+        for (const auto& block : index_.blocks) {
+            segment::putFixed64(footer, block.offset);
+            segment::putFixed32(footer, block.length);
+            segment::putFixed32(footer, block.sessionCount);
+            segment::putFixed64(footer, static_cast<uint64_t>(block.firstStart));
+            segment::putFixed64(footer, static_cast<uint64_t>(block.lastEnd));
+        }
+        segment::putFixed64(footer, footerOffset);
+        footer += kSegmentTrailerMagic;
+        bool complete = writeLocked(footer);
+
+        std::fclose(file_);
+        file_ = nullptr;
+
+        index_.complete = complete;
+        index_.bytes = offset_;
+        writeSegmentIndex(indexPath_, index_);
+    }
+
+    bool SegmentFileSink::rotateLocked()
+    {
+        finishSegmentLocked();
+
+        // Rotating on time alone leaves empty segments behind when there is
+        // no traffic; they are not worth keeping
+        if (index_.sessionCount == 0) {
+            std::error_code error;
+            std::filesystem::remove(path_, error);
+            std::filesystem::remove(indexPath_, error);
+        }
+
+        bool ok = openSegmentLocked();
+        applyRetentionLocked();
+        return ok;
+    }
+
+    bool SegmentFileSink::shouldRotateLocked(WallClock::time_point now) const
+    {
+        return (options_.rotateBytes > 0 && offset_ >= options_.rotateBytes) ||
+            (options_.rotateInterval > 0 && now >= rotateAt_);
+    }
+
+    void SegmentFileSink::applyRetentionLocked()
+    {
+        lastRetention_ = Clock::now();
+        if (options_.maxAge <= 0 && options_.maxTotalBytes == 0) {
+            return;
+        }
+
+        struct Existing {
+            std::filesystem::path path;
+            uint64_t size;
+            std::filesystem::file_time_type modified;
+        };
+        std::vector<Existing> segments;
+        uint64_t total = offset_;
+        std::string prefix = stem_ + ".";
+
+        try {
+            std::filesystem::path directory = directory_.empty() ? "." : directory_;
+            for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+                // Only this series (<stem>.<time>...), which leaves out the
+                // segments of other fanout members
+                std::string name = entry.path().filename().string();
+                if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+                    !std::isdigit(static_cast<unsigned char>(name[prefix.size()])) ||
+                    entry.path().extension() != extension_ || name == index_.segment) {
+                    continue;
+                }
+                segments.push_back({entry.path(), entry.file_size(), entry.last_write_time()});
+                total += segments.back().size;
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::warn("Failed to list segments in {}: {}", directory_, e.what());
+            return;
+        }
+
+        // Names sort by the time the segment was started (the stem, so that
+        // a -1 suffix comes after the name it was added to)
+        std::sort(segments.begin(), segments.end(), [](const Existing& a, const Existing& b) {
+            return a.path.stem() < b.path.stem();
+        });
+
+        auto cutoff = std::filesystem::file_time_type::clock::now() -
+            std::chrono::duration_cast<std::filesystem::file_time_type::duration>(
+                std::chrono::duration<double>(options_.maxAge));
+        for (const auto& old : segments) {
+            bool expired = options_.maxAge > 0 && old.modified < cutoff;
+            bool over = options_.maxTotalBytes > 0 && total > options_.maxTotalBytes;
+            if (!expired && !over) {
+                continue;
+            }
+
+            std::error_code error;
+            if (!std::filesystem::remove(old.path, error)) {
+                spdlog::warn("Failed to delete segment {}: {}", old.path.string(), error.message());
+                continue;
+            }
+            std::filesystem::remove(segmentIndexPath(old.path.string()), error);
+            total -= old.size;
+            spdlog::info("Deleted segment {} ({})", old.path.string(),
+                expired ? "older than max_age_hours" : "over max_total_bytes");
+        }
+    }
+
+    bool SegmentFileSink::flushLocked()
+    {
+        if (encoder_.getSessionCount() == 0) {
+            return true;
+        }
+
+        SegmentBlockInfo block;
+        block.offset = offset_;
+        pending_.clear();
+        encoder_.finish(pending_, block);
+        if (!writeLocked(pending_)) {
+            return false;
+        }
+
+        // The sidecar follows every block so it is usable even if the
+        // segment is never finished
+        index_.add(block);
+        index_.bytes = offset_;
+        writeSegmentIndex(indexPath_, index_);
+        return true;
+    }
+
+    bool SegmentFileSink::writeLocked(const std::string& bytes)
+    {
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file_) == bytes.size() &&
+            std::fflush(file_) == 0;
+        if (!ok) {
+            spdlog::error("Failed to write to {}", path_);
+            return false;
+        }
+        offset_ += bytes.size();
+        bytesWritten_ += bytes.size();
+        return true;
+    }
+
+}
@@ -0,0 +1,153 @@
+#include "rewind/output/SegmentFormat.h"
+#include <cmath>
+
+#ifdef REWIND_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace rwd {
+
+    namespace segment {
+
+        namespace {
+            // Deflate cannot expand input by more than this (about 1032:1
+            // for a long run of one byte), plus a little for short streams
+            constexpr size_t kMaxInflateRatio = 1032;
+            constexpr size_t kInflateSlack = 1024;
+        }
+
+        void putVarint(std::string& out, uint64_t value)
+        {
+            while (value >= 0x80) {
+                out += static_cast<char>((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+            out += static_cast<char>(value);
+        }
+
+        // Zigzag, so small negative values stay short
+        void putSigned(std::string& out, int64_t value)
+        {
+            putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+
+        void putFixed32(std::string& out, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++) {
+                out += static_cast<char>(value >> (i * 8));
+            }
+        }
+
+        void putFixed64(std::string& out, uint64_t value)
+        {
+            for (int i = 0; i < 8; i++) {
+                out += static_cast<char>(value >> (i * 8));
+            }
+        }
+
+        bool getVarint(std::string_view& in, uint64_t& value)
+        {
+            value = 0;
+            for (size_t i = 0; i < in.size() && i < 10; i++) {
+                uint8_t byte = static_cast<uint8_t>(in[i]);
+                value |= static_cast<uint64_t>(byte & 0x7F) << (i * 7);
+                if ((byte & 0x80) == 0) {
+                    in.remove_prefix(i + 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool getSigned(std::string_view& in, int64_t& value)
+        {
+            uint64_t encoded;
+            if (!getVarint(in, encoded)) {
+                return false;
+            }
+            value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+            return true;
+        }
+
+        bool getFixed32(std::string_view& in, uint32_t& value)
+        {
+            if (in.size() < 4) {
+                return false;
+            }
+            value = 0;
+            for (int i = 0; i < 4; i++) {
+                value |= static_cast<uint32_t>(static_cast<uint8_t>(in[i])) << (i * 8);
+            }
+            in.remove_prefix(4);
+            return true;
+        }
+
+        bool getFixed64(std::string_view& in, uint64_t& value)
+        {
+            if (in.size() < 8) {
+                return false;
+            }
+            value = 0;
+            for (int i = 0; i < 8; i++) {
+                value |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (i * 8);
+            }
+            in.remove_prefix(8);
+            return true;
+        }
+
+        bool deflateColumn(std::string_view raw, std::string& out)
+        {
+#ifdef REWIND_HAVE_ZLIB
+            // Small columns are not worth the zlib header
+            if (raw.size() < 64) {
+                return false;
+            }
+
+            uLongf length = compressBound(static_cast<uLong>(raw.size()));
+            out.resize(length);
+            // Fastest level: the dictionaries have already taken out most of
+            // the repetition
+            if (compress2(reinterpret_cast<Bytef*>(out.data()), &length,
+                    reinterpret_cast<const Bytef*>(raw.data()), static_cast<uLong>(raw.size()),
+                    Z_BEST_SPEED) != Z_OK || length >= raw.size()) {
+                return false;
+            }
+            out.resize(length);
+            return true;
+#else
+            (void)raw;
+            (void)out;
+            return false;
+#endif
+        }
+
+        bool inflateColumn(std::string_view stored, size_t rawLength, std::string& out)
+        {
+#ifdef REWIND_HAVE_ZLIB
+            // The length comes from the file; a damaged one must not make us
+            // allocate more than the stored bytes could possibly inflate to
+            if (rawLength > stored.size() * kMaxInflateRatio + kInflateSlack) {
+                return false;
+            }
+
+            uLongf length = static_cast<uLongf>(rawLength);
+            out.resize(rawLength);
+            return uncompress(reinterpret_cast<Bytef*>(out.data()), &length,
+                reinterpret_cast<const Bytef*>(stored.data()), static_cast<uLong>(stored.size())) == Z_OK &&
+                length == rawLength;
+#else
+            (void)stored;
+            (void)rawLength;
+            (void)out;
+            return false;
+#endif
+        }
+
+        int64_t toMicros(double seconds)
+        {
+            return std::llround(seconds * 1e6);
+        }
+
+    }
+
+}
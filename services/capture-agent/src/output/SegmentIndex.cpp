@@ -0,0 +1,108 @@
+#include "rewind/output/SegmentIndex.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+namespace rwd {
+
+    void SegmentIndex::add(const SegmentBlockInfo& block)
+    {
+        // Blocks written before unset session starts were excluded can
+        // start at zero; that would match every query
+        int64_t blockStart = block.firstStart != 0 ? block.firstStart : block.lastEnd;
+        if (blocks.empty() || blockStart < firstStart) {
+            firstStart = blockStart;
+        }
+        if (blocks.empty() || block.lastEnd > lastEnd) {
+            lastEnd = block.lastEnd;
+        }
+        sessionCount += block.sessionCount;
+        blocks.push_back(block);
+    }
+
+    bool SegmentIndex::overlaps(int64_t from, int64_t to) const
+    {
+        return sessionCount > 0 && firstStart <= to && lastEnd >= from;
+    }
+
+    std::string segmentIndexPath(const std::string& segmentPath)
+    {
+        return std::filesystem::path(segmentPath).replace_extension(".rwidx").string();
+    }
+
+    bool writeSegmentIndex(const std::string& path, const SegmentIndex& index)
+    {
+        nlohmann::json blocks = nlohmann::json::array();
+        for (const auto& block : index.blocks) {
+            blocks.push_back({
+                {"offset", block.offset},
+                {"length", block.length},
+                {"sessionCount", block.sessionCount},
+                {"firstStart", block.firstStart},
+                {"lastEnd", block.lastEnd}
+            });
+        }
+
+        nlohmann::json doc = {
+            {"segment", index.segment},
+            {"complete", index.complete},
+            {"bytes", index.bytes},
+            {"sessionCount", index.sessionCount},
+            {"firstStart", index.firstStart},
+            {"lastEnd", index.lastEnd},
+            {"blocks", std::move(blocks)}
+        };
+
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out << doc.dump() << '\n';
+            if (!out) {
+                spdlog::error("Failed to write {}", temporary);
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            spdlog::error("Failed to replace {}: {}", path, error.message());
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool readSegmentIndex(const std::string& path, SegmentIndex& index)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            return false;
+        }
+
+        try {
+            nlohmann::json doc = nlohmann::json::parse(in);
+            index = SegmentIndex();
+            index.segment = doc.at("segment").get<std::string>();
+            index.complete = doc.at("complete").get<bool>();
+            index.bytes = doc.at("bytes").get<uint64_t>();
+            for (const auto& entry : doc.at("blocks")) {
+                SegmentBlockInfo block;
+                block.offset = entry.at("offset").get<uint64_t>();
+                block.length = entry.at("length").get<uint32_t>();
+                block.sessionCount = entry.at("sessionCount").get<uint32_t>();
+                block.firstStart = entry.at("firstStart").get<int64_t>();
+                block.lastEnd = entry.at("lastEnd").get<int64_t>();
+                index.add(block);
+            }
+        }
+        catch (const std::exception& e) {
+            spdlog::error("Failed to parse {}: {}", path, e.what());
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,658 @@
+#include "rewind/output/SegmentReader.h"
+#include "rewind/capture/FlowKey.h"
+#include "rewind/output/JsonWriter.h"
+#include <algorithm>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+namespace rwd {
+
+    namespace {
+        constexpr size_t kBlockFixedHeader = 12;
+        // Far more than any writer produces; guards against reading garbage
+        constexpr uint32_t kMaxColumns = 1024;
+
+        bool getByte(std::string_view& in, uint8_t& value)
+        {
+            if (in.empty()) {
+                return false;
+            }
+            value = static_cast<uint8_t>(in.front());
+            in.remove_prefix(1);
+            return true;
+        }
+
+        bool parseBlockHeader(std::string_view& in, uint32_t& sessionCount,
+            std::vector<SegmentColumnLength>& columnLengths)
+        {
+            uint32_t magic;
+            uint32_t columnCount;
+            if (!segment::getFixed32(in, magic) || magic != kSegmentBlockMagic ||
+                !segment::getFixed32(in, sessionCount) ||
+                !segment::getFixed32(in, columnCount) || columnCount > kMaxColumns) {
+                return false;
+            }
+
+            columnLengths.resize(columnCount);
+            for (auto& length : columnLengths) {
+                if (!segment::getFixed32(in, length.stored) || !segment::getFixed32(in, length.raw) ||
+                    length.stored > length.raw) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Inflates the column if it was stored deflated
+        bool loadColumn(std::string_view stored, const SegmentColumnLength& length, std::string& out)
+        {
+            if (length.stored == length.raw) {
+                out.assign(stored);
+                return true;
+            }
+            return segment::inflateColumn(stored, length.raw, out);
+        }
+
+        // Reads back what SegmentDictionary wrote
+        class DictionaryReader {
+        public:
+            explicit DictionaryReader(std::string_view column)
+                : in_(column)
+            {
+            }
+
+            bool next(std::string_view& value)
+            {
+                uint64_t code;
+                if (!segment::getVarint(in_, code)) {
+                    return false;
+                }
+                if (code == 0) {
+                    uint64_t length;
+                    if (!segment::getVarint(in_, length) || length > in_.size()) {
+                        return false;
+                    }
+                    value = in_.substr(0, length);
+                    in_.remove_prefix(length);
+                    entries_.push_back(value);
+                    return true;
+                }
+                if (code > entries_.size()) {
+                    return false;
+                }
+                value = entries_[code - 1];
+                return true;
+            }
+
+            // For columns that interleave counts with values
+            bool count(uint64_t& value) { return segment::getVarint(in_, value); }
+
+        private:
+            std::string_view in_;
+            std::vector<std::string_view> entries_;
+        };
+
+        // Walks all columns of one block in step, writing JSON
+        class BlockDecoder {
+        public:
+            explicit BlockDecoder(const std::vector<std::string_view>& columns)
+                : flows_(column(columns, SegmentColumn::Flows))
+                , sessionTimes_(column(columns, SegmentColumn::SessionTimes))
+                , transactionTimes_(column(columns, SegmentColumn::TransactionTimes))
+                , heads_(column(columns, SegmentColumn::MessageHeads))
+                , bodies_(column(columns, SegmentColumn::Bodies))
+                , blob_(column(columns, SegmentColumn::Blob))
+                , methods_(column(columns, SegmentColumn::Methods))
+                , uris_(column(columns, SegmentColumn::Uris))
+                , statusMessages_(column(columns, SegmentColumn::StatusMessages))
+                , versions_(column(columns, SegmentColumn::Versions))
+                , headerNames_(column(columns, SegmentColumn::HeaderNames))
+                , headerValues_(column(columns, SegmentColumn::HeaderValues))
+                , bodyTypes_(column(columns, SegmentColumn::BodyTypes))
+                , previousStart_(0)
+            {
+            }
+
+            // Mirrors Session::writeJson. start and end are the session's,
+            // in microseconds.
+            bool writeSession(JsonWriter& writer, int64_t& start, int64_t& end)
+            {
+                FlowKey flow;
+                uint8_t ipVersion;
+                if (!getByte(flows_, ipVersion)) {
+                    return false;
+                }
+                size_t addressLength = ipVersion == 6 ? 16 : 4;
+                if (flows_.size() < addressLength * 2) {
+                    return false;
+                }
+                flow.ipVersion = ipVersion;
+                std::copy_n(flows_.data(), addressLength, flow.clientAddress.begin());
+                std::copy_n(flows_.data() + addressLength, addressLength, flow.serverAddress.begin());
+                flows_.remove_prefix(addressLength * 2);
+
+                uint64_t clientPort;
+                uint64_t serverPort;
+                int64_t startDelta;
+                int64_t length;
+                uint64_t transactionCount;
+                uint64_t emitted;
+                if (!segment::getVarint(flows_, clientPort) || !segment::getVarint(flows_, serverPort) ||
+                    !segment::getSigned(sessionTimes_, startDelta) || !segment::getSigned(sessionTimes_, length) ||
+                    !segment::getVarint(sessionTimes_, transactionCount) || !segment::getVarint(sessionTimes_, emitted)) {
+                    return false;
+                }
+                flow.clientPort = static_cast<uint16_t>(clientPort);
+                flow.serverPort = static_cast<uint16_t>(serverPort);
+                start = previousStart_ + startDelta;
+                end = start + length;
+                previousStart_ = start;
+
+                writer.beginObject();
+                writer.field("sessionId", flow.sessionId(start));
+                writer.field("clientIp", flow.clientIp());
+                writer.field("clientPort", flow.clientPort);
+                writer.field("serverIp", flow.serverIp());
+                writer.field("serverPort", flow.serverPort);
+                writer.field("startTime", segment::fromMicros(start));
+                writer.field("endTime", segment::fromMicros(end));
+                writer.field("duration", segment::fromMicros(length));
+                writer.field("transactionCount", transactionCount);
+
+                writer.key("transactions");
+                writer.beginArray();
+                for (uint64_t i = 0; i < emitted; i++) {
+                    if (!writeTransaction(writer, start)) {
+                        return false;
+                    }
+                }
+                writer.endArray();
+
+                writer.endObject();
+                return true;
+            }
+
+        private:
+            static std::string_view column(const std::vector<std::string_view>& columns, SegmentColumn id)
+            {
+                size_t index = static_cast<size_t>(id);
+                return index < columns.size() ? columns[index] : std::string_view();
+            }
+
+            // Mirrors HttpTransaction::writeJson
+            bool writeTransaction(JsonWriter& writer, int64_t sessionStart)
+            {
+                uint8_t presence;
+                if (!getByte(transactionTimes_, presence)) {
+                    return false;
+                }
+
+                writer.beginObject();
+
+                int64_t requestTime = 0;
+                if (presence & kSegmentHasRequest) {
+                    int64_t offset;
+                    if (!segment::getSigned(transactionTimes_, offset)) {
+                        return false;
+                    }
+                    requestTime = sessionStart + offset;
+
+                    writer.key("request");
+                    if (!writeMessage(writer)) {
+                        return false;
+                    }
+                    writer.field("requestTime", segment::fromMicros(requestTime));
+                }
+
+                if (presence & kSegmentHasResponse) {
+                    int64_t offset;
+                    if (!segment::getSigned(transactionTimes_, offset)) {
+                        return false;
+                    }
+                    bool complete = presence & kSegmentHasRequest;
+                    int64_t responseTime = complete ? requestTime + offset : sessionStart + offset;
+
+                    writer.key("response");
+                    if (!writeMessage(writer)) {
+                        return false;
+                    }
+                    writer.field("responseTime", segment::fromMicros(responseTime));
+                    if (complete) {
+                        writer.field("duration", segment::fromMicros(offset));
+                    }
+                }
+
+                writer.endObject();
+                return true;
+            }
+
+            // Mirrors HttpMessage::writeJson
+            bool writeMessage(JsonWriter& writer)
+            {
+                uint8_t type;
+                if (!getByte(heads_, type)) {
+                    return false;
+                }
+
+                writer.beginObject();
+
+                if (type == 0) {
+                    std::string_view method;
+                    std::string_view uri;
+                    if (!methods_.next(method) || !uris_.next(uri)) {
+                        return false;
+                    }
+                    writer.field("type", "request");
+                    if (!method.empty()) writer.field("method", method);
+                    if (!uri.empty()) writer.field("uri", uri);
+                }
+                else {
+                    int64_t statusCode;
+                    std::string_view statusMessage;
+                    if (!segment::getSigned(heads_, statusCode) || !statusMessages_.next(statusMessage)) {
+                        return false;
+                    }
+                    writer.field("type", "response");
+                    writer.field("statusCode", static_cast<int>(statusCode));
+                    if (!statusMessage.empty()) writer.field("statusMessage", statusMessage);
+                }
+
+                std::string_view version;
+                uint64_t length;
+                if (!versions_.next(version) || !segment::getVarint(heads_, length)) {
+                    return false;
+                }
+                if (!version.empty()) {
+                    writer.field("version", version);
+                }
+                writer.field("length", static_cast<int>(length));
+
+                uint64_t headerCount;
+                if (!headerNames_.count(headerCount)) {
+                    return false;
+                }
+                if (headerCount > 0) {
+                    writer.key("headers");
+                    writer.beginObject();
+                    for (uint64_t i = 0; i < headerCount; i++) {
+                        std::string_view name;
+                        std::string_view value;
+                        if (!headerNames_.next(name) || !headerValues_.next(value)) {
+                            return false;
+                        }
+                        writer.field(name, value);
+                    }
+                    writer.endObject();
+                }
+
+                if (!writeBody(writer)) {
+                    return false;
+                }
+
+                writer.endObject();
+                return true;
+            }
+
+            bool writeBody(JsonWriter& writer)
+            {
+                uint8_t flags;
+                if (!getByte(bodies_, flags)) {
+                    return false;
+                }
+                uint8_t kind = flags & kSegmentBodyKindMask;
+                if (kind == kSegmentBodyNone) {
+                    return true;
+                }
+
+                uint64_t bodyLength;
+                uint64_t capturedLength = 0;
+                if (!segment::getVarint(bodies_, bodyLength) ||
+                    ((flags & kSegmentBodyCaptureCut) && !segment::getVarint(bodies_, capturedLength))) {
+                    return false;
+                }
+
+                writer.field("bodyLength", bodyLength);
+                if (flags & kSegmentBodyTruncated) {
+                    writer.field("bodyTruncated", true);
+                }
+                if (flags & kSegmentBodyCaptureCut) {
+                    writer.field("capturedBodyLength", capturedLength);
+                }
+                if (flags & kSegmentBodyDecoded) {
+                    writer.field("bodyDecoded", true);
+                }
+
+                if (kind == kSegmentBodyType) {
+                    std::string_view bodyType;
+                    if (!bodyTypes_.next(bodyType)) {
+                        return false;
+                    }
+                    writer.field("bodyType", bodyType);
+                    return true;
+                }
+
+                uint64_t textLength;
+                if (!segment::getVarint(bodies_, textLength) || textLength > blob_.size()) {
+                    return false;
+                }
+                writer.field(kind == kSegmentBodyText ? "body" : "bodyPreview", blob_.substr(0, textLength));
+                blob_.remove_prefix(textLength);
+                return true;
+            }
+
+            std::string_view flows_;
+            std::string_view sessionTimes_;
+            std::string_view transactionTimes_;
+            std::string_view heads_;
+            std::string_view bodies_;
+            std::string_view blob_;
+            DictionaryReader methods_;
+            DictionaryReader uris_;
+            DictionaryReader statusMessages_;
+            DictionaryReader versions_;
+            DictionaryReader headerNames_;
+            DictionaryReader headerValues_;
+            DictionaryReader bodyTypes_;
+            int64_t previousStart_;
+        };
+    }
+
+    SegmentReader::SegmentReader()
+        : fileSize_(0)
+        , hasFooter_(false)
+    {
+    }
+
+    bool SegmentReader::open(const std::string& path)
+    {
+        path_ = path;
+        blocks_.clear();
+        hasFooter_ = false;
+
+        in_.open(path, std::ios::binary);
+        if (!in_.is_open()) {
+            spdlog::error("Failed to open {}", path);
+            return false;
+        }
+        in_.seekg(0, std::ios::end);
+        fileSize_ = static_cast<uint64_t>(in_.tellg());
+
+        std::string magic;
+        if (!readAt(0, kSegmentMagic.size(), magic) || magic != kSegmentMagic) {
+            spdlog::error("{} is not a session segment", path);
+            return false;
+        }
+
+        if (!readFooter()) {
+            walkBlocks();
+            spdlog::warn("{} has no footer (writer did not finish); found {} complete blocks",
+                path, blocks_.size());
+        }
+        return true;
+    }
+
+    bool SegmentReader::readAt(uint64_t offset, size_t length, std::string& out)
+    {
+        if (offset > fileSize_ || length > fileSize_ - offset) {
+            return false;
+        }
+
+        out.resize(length);
+        in_.clear();
+        in_.seekg(static_cast<std::streamoff>(offset));
+        in_.read(out.data(), static_cast<std::streamsize>(length));
+        return static_cast<size_t>(in_.gcount()) == length;
+    }
+
+    bool SegmentReader::readFooter()
+    {
+        std::string trailer;
+        if (fileSize_ < kSegmentMagic.size() + kSegmentTrailerSize ||
+            !readAt(fileSize_ - kSegmentTrailerSize, kSegmentTrailerSize, trailer)) {
+            return false;
+        }
+
+        std::string_view in(trailer);
+        uint64_t footerOffset;
+        segment::getFixed64(in, footerOffset);
+        if (in != kSegmentTrailerMagic || footerOffset > fileSize_ - kSegmentTrailerSize) {
+            return false;
+        }
+
+        std::string footer;
+        if (!readAt(footerOffset, fileSize_ - kSegmentTrailerSize - footerOffset, footer)) {
+            return false;
+        }
+
+        in = footer;
+        uint32_t blockCount;
+        if (!segment::getFixed32(in, blockCount) || in.size() != blockCount * kSegmentBlockInfoSize) {
+            return false;
+        }
+
+        blocks_.resize(blockCount);
+        for (auto& block : blocks_) {
+            uint64_t firstStart;
+            uint64_t lastEnd;
+            segment::getFixed64(in, block.offset);
+            segment::getFixed32(in, block.length);
+            segment::getFixed32(in, block.sessionCount);
+            segment::getFixed64(in, firstStart);
+            segment::getFixed64(in, lastEnd);
+            block.firstStart = static_cast<int64_t>(firstStart);
+            block.lastEnd = static_cast<int64_t>(lastEnd);
+        }
+
+        hasFooter_ = true;
+        return true;
+    }
+
+    void SegmentReader::walkBlocks()
+    {
+        blocks_.clear();
+
+        uint64_t offset = kSegmentMagic.size();
+        std::vector<SegmentColumnLength> columnLengths;
+        std::string sessionTimes;
+        while (offset < fileSize_) {
+            SegmentBlockInfo block;
+            size_t headerLength;
+            if (!readBlockLayout(offset, block.sessionCount, columnLengths, headerLength)) {
+                break;
+            }
+
+            uint64_t length = headerLength;
+            for (const auto& columnLength : columnLengths) {
+                length += columnLength.stored;
+            }
+            if (length > fileSize_ - offset) {
+                break;  // Torn by the writer dying
+            }
+            block.offset = offset;
+            block.length = static_cast<uint32_t>(length);
+            blocks_.push_back(block);
+
+            // The time range is not in the block header; work it out from
+            // the session starts and lengths
+            if (readColumn(blocks_.size() - 1, SegmentColumn::SessionTimes, sessionTimes)) {
+                std::string_view in(sessionTimes);
+                int64_t start = 0;
+                for (uint32_t i = 0; i < block.sessionCount; i++) {
+                    int64_t delta;
+                    int64_t sessionLength;
+                    uint64_t count;
+                    if (!segment::getSigned(in, delta) || !segment::getSigned(in, sessionLength) ||
+                        !segment::getVarint(in, count) || !segment::getVarint(in, count)) {
+                        break;
+                    }
+                    start += delta;
+                    SegmentBlockInfo& info = blocks_.back();
+                    // Unset starts count as the session's end, as when writing
+                    int64_t rangeStart = start != 0 ? start : start + sessionLength;
+                    if (i == 0 || rangeStart < info.firstStart) {
+                        info.firstStart = rangeStart;
+                    }
+                    if (i == 0 || start + sessionLength > info.lastEnd) {
+                        info.lastEnd = start + sessionLength;
+                    }
+                }
+            }
+
+            offset += length;
+        }
+    }
+
+    bool SegmentReader::readBlockLayout(uint64_t offset, uint32_t& sessionCount,
+        std::vector<SegmentColumnLength>& columnLengths, size_t& headerLength)
+    {
+        std::string header;
+        if (!readAt(offset, kBlockFixedHeader, header)) {
+            return false;
+        }
+
+        std::string_view in(header);
+        uint32_t columnCount;
+        in.remove_prefix(8);
+        if (!segment::getFixed32(in, columnCount) || columnCount > kMaxColumns) {
+            return false;
+        }
+
+        headerLength = kBlockFixedHeader + columnCount * 8;
+        if (!readAt(offset, headerLength, header)) {
+            return false;
+        }
+        in = header;
+        return parseBlockHeader(in, sessionCount, columnLengths);
+    }
+
+    bool SegmentReader::readColumn(size_t block, SegmentColumn column, std::string& out)
+    {
+        out.clear();
+        if (block >= blocks_.size()) {
+            return false;
+        }
+
+        uint32_t sessionCount;
+        std::vector<SegmentColumnLength> columnLengths;
+        size_t headerLength;
+        if (!readBlockLayout(blocks_[block].offset, sessionCount, columnLengths, headerLength)) {
+            spdlog::error("{}: block {} is damaged", path_, block);
+            return false;
+        }
+
+        size_t index = static_cast<size_t>(column);
+        if (index >= columnLengths.size()) {
+            return true;  // Written before this column existed
+        }
+
+        uint64_t offset = blocks_[block].offset + headerLength;
+        for (size_t i = 0; i < index; i++) {
+            offset += columnLengths[i].stored;
+        }
+
+        std::string stored;
+        if (!readAt(offset, columnLengths[index].stored, stored) ||
+            !loadColumn(stored, columnLengths[index], out)) {
+            spdlog::error("{}: column {} of block {} cannot be read", path_, index, block);
+            return false;
+        }
+        return true;
+    }
+
+    bool SegmentReader::readSessions(size_t block, const std::function<void(std::string_view)>& fn)
+    {
+        return readSessions(block, fn, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+    }
+
+    bool SegmentReader::readSessions(size_t block, const std::function<void(std::string_view)>& fn,
+        int64_t from, int64_t to)
+    {
+        if (block >= blocks_.size()) {
+            return false;
+        }
+
+        std::string bytes;
+        if (!readAt(blocks_[block].offset, blocks_[block].length, bytes)) {
+            spdlog::error("{}: block {} is cut short", path_, block);
+            return false;
+        }
+
+        std::string_view in(bytes);
+        uint32_t sessionCount;
+        std::vector<SegmentColumnLength> columnLengths;
+        if (!parseBlockHeader(in, sessionCount, columnLengths)) {
+            spdlog::error("{}: block {} is damaged", path_, block);
+            return false;
+        }
+
+        // Deflated columns are inflated into these; the rest are read in place
+        std::vector<std::string> inflated(columnLengths.size());
+        std::vector<std::string_view> columns;
+        for (size_t i = 0; i < columnLengths.size(); i++) {
+            const SegmentColumnLength& length = columnLengths[i];
+            if (length.stored > in.size()) {
+                spdlog::error("{}: block {} is damaged", path_, block);
+                return false;
+            }
+            std::string_view stored = in.substr(0, length.stored);
+            in.remove_prefix(length.stored);
+            if (length.stored == length.raw) {
+                columns.push_back(stored);
+            }
+            else if (loadColumn(stored, length, inflated[i])) {
+                columns.push_back(inflated[i]);
+            }
+            else {
+                spdlog::error("{}: column {} of block {} cannot be read", path_, i, block);
+                return false;
+            }
+        }
+
+        BlockDecoder decoder(columns);
+        std::string rendered;
+        for (uint32_t i = 0; i < sessionCount; i++) {
+            // Sessions outside the range still have to be decoded to move
+            // the columns along
+            rendered.clear();
+            JsonWriter writer(rendered);
+            int64_t start;
+            int64_t end;
+            if (!decoder.writeSession(writer, start, end)) {
+                spdlog::error("{}: block {} is damaged at session {}", path_, block, i);
+                return false;
+            }
+            if (start <= to && end >= from) {
+                fn(rendered);
+            }
+        }
+        return true;
+    }
+
+    bool SegmentReader::readDurations(size_t block, std::vector<int64_t>& durations)
+    {
+        std::string column;
+        if (!readColumn(block, SegmentColumn::TransactionTimes, column)) {
+            return false;
+        }
+
+        std::string_view in(column);
+        while (!in.empty()) {
+            uint8_t presence;
+            int64_t value;
+            getByte(in, presence);
+            if ((presence & kSegmentHasRequest) && !segment::getSigned(in, value)) {
+                return false;
+            }
+            if (presence & kSegmentHasResponse) {
+                if (!segment::getSigned(in, value)) {
+                    return false;
+                }
+                if (presence & kSegmentHasRequest) {
+                    durations.push_back(value);
+                }
+            }
+        }
+        return true;
+    }
+
+}
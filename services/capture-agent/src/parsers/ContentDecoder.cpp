@@ -0,0 +1,179 @@
+#include "rewind/parsers/ContentDecoder.h"
+#include "rewind/parsers/HeaderNames.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#ifdef REWIND_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef REWIND_HAVE_BROTLI
+#include <brotli/decode.h>
+#endif
+
+namespace rwd {
+
+    namespace {
+        // Output is produced in steps of this size so the cap is honoured
+        // without allocating it up front
+        constexpr size_t kDecodeStep = 16 * 1024;
+
+#ifdef REWIND_HAVE_ZLIB
+        // windowBits: 15 + 32 detects a zlib or gzip header, -15 is raw deflate
+        bool inflateWith(int windowBits, std::string_view input, size_t maxOutput,
+            std::string& output, bool& truncated)
+        {
+            z_stream stream{};
+            if (inflateInit2(&stream, windowBits) != Z_OK) {
+                return false;
+            }
+
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            stream.avail_in = static_cast<uInt>(input.length());
+
+            int status = Z_OK;
+            while (status == Z_OK && output.length() < maxOutput) {
+                size_t offset = output.length();
+                size_t step = std::min(kDecodeStep, maxOutput - offset);
+                output.resize(offset + step);
+
+                stream.next_out = reinterpret_cast<Bytef*>(&output[offset]);
+                stream.avail_out = static_cast<uInt>(step);
+                status = inflate(&stream, Z_NO_FLUSH);
+                output.resize(offset + step - stream.avail_out);
+
+                if (status == Z_BUF_ERROR && stream.avail_in == 0) {
+                    // Captured body ended early; keep what we have
+                    status = Z_STREAM_END;
+                }
+            }
+
+            truncated = (status == Z_OK);
+            inflateEnd(&stream);
+            return status == Z_OK || status == Z_STREAM_END;
+        }
+#endif
+
+#ifdef REWIND_HAVE_BROTLI
+        bool decodeBrotli(std::string_view input, size_t maxOutput, std::string& output, bool& truncated)
+        {
+            BrotliDecoderState* state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+            if (!state) {
+                return false;
+            }
+
+            const uint8_t* nextIn = reinterpret_cast<const uint8_t*>(input.data());
+            size_t availableIn = input.length();
+
+            BrotliDecoderResult result = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+            while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT && output.length() < maxOutput) {
+                size_t offset = output.length();
+                size_t step = std::min(kDecodeStep, maxOutput - offset);
+                output.resize(offset + step);
+
+                uint8_t* nextOut = reinterpret_cast<uint8_t*>(&output[offset]);
+                size_t availableOut = step;
+                result = BrotliDecoderDecompressStream(state, &availableIn, &nextIn, &availableOut, &nextOut, nullptr);
+                output.resize(offset + step - availableOut);
+            }
+
+            truncated = (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+            BrotliDecoderDestroyInstance(state);
+
+            // NEEDS_MORE_INPUT means the captured body ended early
+            return result != BROTLI_DECODER_RESULT_ERROR;
+        }
+#endif
+    }
+
+    ContentDecoder::Encoding ContentDecoder::parse(std::string_view contentEncoding)
+    {
+        size_t start = contentEncoding.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            return Encoding::Identity;
+        }
+        size_t end = contentEncoding.find_last_not_of(" \t");
+        std::string_view coding = contentEncoding.substr(start, end - start + 1);
+
+        if (HeaderNames::equalsIgnoreCase(coding, "identity")) {
+            return Encoding::Identity;
+        }
+        if (HeaderNames::equalsIgnoreCase(coding, "gzip") || HeaderNames::equalsIgnoreCase(coding, "x-gzip")) {
+            return Encoding::Gzip;
+        }
+        if (HeaderNames::equalsIgnoreCase(coding, "deflate")) {
+            return Encoding::Deflate;
+        }
+        if (HeaderNames::equalsIgnoreCase(coding, "br")) {
+            return Encoding::Brotli;
+        }
+        return Encoding::Unsupported;
+    }
+
+    bool ContentDecoder::isAvailable(Encoding encoding)
+    {
+        switch (encoding) {
+        case Encoding::Identity:
+            return true;
+#ifdef REWIND_HAVE_ZLIB
+        case Encoding::Gzip:
+        case Encoding::Deflate:
+            return true;
+#endif
+#ifdef REWIND_HAVE_BROTLI
+        case Encoding::Brotli:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    const char* ContentDecoder::name(Encoding encoding)
+    {
+        switch (encoding) {
+        case Encoding::Identity: return "identity";
+        case Encoding::Gzip: return "gzip";
+        case Encoding::Deflate: return "deflate";
+        case Encoding::Brotli: return "br";
+        default: return "unsupported";
+        }
+    }
+
+    bool ContentDecoder::decode(Encoding encoding, std::string_view input, size_t maxOutput,
+        std::string& output, bool& truncated)
+    {
+        output.clear();
+        truncated = false;
+
+        switch (encoding) {
+        case Encoding::Identity:
+            output.assign(input.substr(0, maxOutput));
+            truncated = input.length() > maxOutput;
+            return true;
+
+#ifdef REWIND_HAVE_ZLIB
+        case Encoding::Gzip:
+            return inflateWith(15 + 32, input, maxOutput, output, truncated);
+
+        case Encoding::Deflate:
+            // "deflate" should be zlib-wrapped, but some servers send it raw
+            if (inflateWith(15 + 32, input, maxOutput, output, truncated)) {
+                return true;
+            }
+            output.clear();
+            return inflateWith(-15, input, maxOutput, output, truncated);
+#endif
+
+#ifdef REWIND_HAVE_BROTLI
+        case Encoding::Brotli:
+            return decodeBrotli(input, maxOutput, output, truncated);
+#endif
+
+        default:
+            spdlog::debug("No decoder for content encoding {}", name(encoding));
+            return false;
+        }
+    }
+
+}
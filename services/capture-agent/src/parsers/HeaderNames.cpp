@@ -0,0 +1,198 @@
+#include "rewind/parsers/HeaderNames.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace rwd {
+
+    namespace {
+        constexpr std::string_view kWellKnown[] = {
+#define REWIND_HEADER_NAME(id, name) name,
+            REWIND_WELL_KNOWN_HEADERS(REWIND_HEADER_NAME)
+#undef REWIND_HEADER_NAME
+        };
+
+        constexpr size_t kWellKnownCount = std::size(kWellKnown);
+        static_assert(kWellKnownCount == static_cast<size_t>(HeaderName::Count));
+
+        constexpr char toLower(char c)
+        {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        // FNV-1a over the lower-cased name
+        constexpr uint32_t hashName(std::string_view name, uint32_t seed)
+        {
+            uint32_t h = 2166136261u ^ seed;
+            for (char c : name) {
+                h ^= static_cast<unsigned char>(toLower(c));
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+        constexpr size_t kSlotCount = 512;
+
+        // Smallest seed for which no two well-known names share a slot
+        constexpr uint32_t findSeed()
+        {
+            for (uint32_t seed = 1; seed < 1u << 16; seed++) {
+                bool used[kSlotCount] = {};
+                bool perfect = true;
+                for (auto name : kWellKnown) {
+                    size_t slot = hashName(name, seed) % kSlotCount;
+                    if (used[slot]) {
+                        perfect = false;
+                        break;
+                    }
+                    used[slot] = true;
+                }
+                if (perfect) {
+                    return seed;
+                }
+            }
+            return 0;
+        }
+
+        constexpr uint32_t kSeed = findSeed();
+        static_assert(kSeed != 0, "no perfect hash seed for the well-known header names");
+
+        constexpr std::array<HeaderId, kSlotCount> buildSlots()
+        {
+            std::array<HeaderId, kSlotCount> slots{};
+            for (auto& slot : slots) {
+                slot = HeaderNames::kNotInterned;
+            }
+            for (size_t i = 0; i < kWellKnownCount; i++) {
+                slots[hashName(kWellKnown[i], kSeed) % kSlotCount] = static_cast<HeaderId>(i);
+            }
+            return slots;
+        }
+
+        constexpr auto kSlots = buildSlots();
+
+        constexpr size_t longestWellKnown()
+        {
+            size_t longest = 0;
+            for (auto name : kWellKnown) {
+                longest = name.length() > longest ? name.length() : longest;
+            }
+            return longest;
+        }
+
+        // Case-insensitive and transparent, so lookups by string_view
+        // neither allocate nor lower-case a copy
+        struct NameHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view name) const { return hashName(name, 0); }
+        };
+
+        struct NameEqual {
+            using is_transparent = void;
+            bool operator()(std::string_view a, std::string_view b) const {
+                return HeaderNames::equalsIgnoreCase(a, b);
+            }
+        };
+
+        struct InternTable {
+            std::shared_mutex mutex;
+            std::unordered_map<std::string, HeaderId, NameHash, NameEqual> ids;
+            std::deque<std::string> names;  // Indexed by id - kWellKnownCount
+            // Set once names reaches kMaxInterned; lets unknown names skip the
+            // exclusive lock from then on
+            std::atomic<bool> full{false};
+        };
+
+        InternTable& internTable()
+        {
+            static InternTable table;
+            return table;
+        }
+    }
+
+    bool HeaderNames::equalsIgnoreCase(std::string_view a, std::string_view b)
+    {
+        if (a.length() != b.length()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.length(); i++) {
+            if (toLower(a[i]) != toLower(b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    HeaderId HeaderNames::wellKnown(std::string_view name)
+    {
+        if (name.empty() || name.length() > longestWellKnown()) {
+            return kNotInterned;
+        }
+
+        HeaderId candidate = kSlots[hashName(name, kSeed) % kSlotCount];
+        if (candidate != kNotInterned && equalsIgnoreCase(kWellKnown[candidate], name)) {
+            return candidate;
+        }
+        return kNotInterned;
+    }
+
+    HeaderId HeaderNames::find(std::string_view name)
+    {
+        HeaderId known = wellKnown(name);
+        if (known != kNotInterned) {
+            return known;
+        }
+
+        InternTable& table = internTable();
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        auto it = table.ids.find(name);
+        return it != table.ids.end() ? it->second : kNotInterned;
+    }
+
+    HeaderId HeaderNames::intern(std::string_view name)
+    {
+        HeaderId found = find(name);
+        if (found != kNotInterned || name.empty()) {
+            return found;
+        }
+
+        InternTable& table = internTable();
+        if (table.full.load(std::memory_order_relaxed)) {
+            return kNotInterned;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(table.mutex);
+        if (table.names.size() >= kMaxInterned) {
+            return kNotInterned;
+        }
+
+        auto [it, inserted] = table.ids.emplace(std::string(name),
+            static_cast<HeaderId>(kWellKnownCount + table.names.size()));
+        if (inserted) {
+            table.names.emplace_back(name);
+            if (table.names.size() >= kMaxInterned) {
+                table.full.store(true, std::memory_order_relaxed);
+            }
+        }
+        return it->second;
+    }
+
+    std::string_view HeaderNames::name(HeaderId id)
+    {
+        if (id < kWellKnownCount) {
+            return kWellKnown[id];
+        }
+
+        InternTable& table = internTable();
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        size_t index = id - kWellKnownCount;
+        // deque elements never move, so the view outlives the lock
+        return index < table.names.size() ? std::string_view(table.names[index]) : std::string_view();
+    }
+
+}
@@ -0,0 +1,144 @@
+#include "rewind/parsers/HeaderScanner.h"
+
+#ifdef REWIND_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace rwd {
+
+    namespace {
+        struct ScanState {
+            uint32_t lineStart = 0;
+            uint32_t colon = HeaderLine::kNoColon;
+        };
+
+        // Handles one '\n' or ':' at offset i. Returns true when the blank
+        // line ending the block was found, with end set past it.
+        inline bool visit(const char* data, size_t i, ScanState& state,
+            std::vector<HeaderLine>& lines, size_t& end)
+        {
+            if (data[i] == ':') {
+                if (state.colon == HeaderLine::kNoColon) {
+                    state.colon = static_cast<uint32_t>(i);
+                }
+                return false;
+            }
+
+            uint32_t lineEnd = static_cast<uint32_t>(i);
+            if (lineEnd > state.lineStart && data[lineEnd - 1] == '\r') {
+                lineEnd--;
+            }
+
+            if (lineEnd == state.lineStart) {
+                end = i + 1;
+                return true;
+            }
+
+            lines.push_back(HeaderLine{state.lineStart, state.colon, lineEnd});
+            state.lineStart = static_cast<uint32_t>(i + 1);
+            state.colon = HeaderLine::kNoColon;
+            return false;
+        }
+
+        size_t scanScalar(const char* data, size_t offset, size_t length, ScanState& state,
+            std::vector<HeaderLine>& lines)
+        {
+            size_t end = HeaderScanner::kNotFound;
+            for (size_t i = offset; i < length; i++) {
+                char c = data[i];
+                if ((c == '\n' || c == ':') && visit(data, i, state, lines, end)) {
+                    return end;
+                }
+            }
+            return HeaderScanner::kNotFound;
+        }
+
+#ifdef REWIND_X86_SIMD
+        __attribute__((target("sse4.2")))
+        size_t scanSse42(const char* data, size_t length, std::vector<HeaderLine>& lines)
+        {
+            ScanState state;
+            size_t end = HeaderScanner::kNotFound;
+            const __m128i needles = _mm_setr_epi8('\n', ':', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+            size_t i = 0;
+            for (; i + 16 <= length; i += 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                __m128i hits = _mm_cmpestrm(needles, 2, block, 16,
+                    _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK);
+                unsigned mask = static_cast<unsigned>(_mm_cvtsi128_si32(hits));
+
+                while (mask) {
+                    size_t bit = static_cast<size_t>(__builtin_ctz(mask));
+                    mask &= mask - 1;
+                    if (visit(data, i + bit, state, lines, end)) {
+                        return end;
+                    }
+                }
+            }
+
+            return scanScalar(data, i, length, state, lines);
+        }
+
+        __attribute__((target("avx2")))
+        size_t scanAvx2(const char* data, size_t length, std::vector<HeaderLine>& lines)
+        {
+            ScanState state;
+            size_t end = HeaderScanner::kNotFound;
+            const __m256i newline = _mm256_set1_epi8('\n');
+            const __m256i colon = _mm256_set1_epi8(':');
+
+            size_t i = 0;
+            for (; i + 32 <= length; i += 32) {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                __m256i hits = _mm256_or_si256(
+                    _mm256_cmpeq_epi8(block, newline),
+                    _mm256_cmpeq_epi8(block, colon));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+
+                while (mask) {
+                    size_t bit = static_cast<size_t>(__builtin_ctz(mask));
+                    mask &= mask - 1;
+                    if (visit(data, i + bit, state, lines, end)) {
+                        return end;
+                    }
+                }
+            }
+
+            return scanScalar(data, i, length, state, lines);
+        }
+#endif
+
+        size_t scanWith(HeaderScanner::Implementation implementation, const char* data, size_t length,
+            std::vector<HeaderLine>& lines)
+        {
+            switch (implementation) {
+#ifdef REWIND_X86_SIMD
+            case HeaderScanner::Implementation::Avx2:
+                return scanAvx2(data, length, lines);
+            case HeaderScanner::Implementation::Sse42:
+                return scanSse42(data, length, lines);
+#endif
+            default: {
+                ScanState state;
+                return scanScalar(data, 0, length, state, lines);
+            }
+            }
+        }
+    }
+
+    size_t HeaderScanner::scan(const char* data, size_t length, std::vector<HeaderLine>& lines)
+    {
+        return scanWith(detectSimdLevel(), data, length, lines);
+    }
+
+    size_t HeaderScanner::scan(const char* data, size_t length, std::vector<HeaderLine>& lines,
+        Implementation implementation)
+    {
+        if (!isSimdLevelSupported(implementation)) {
+            implementation = Implementation::Scalar;
+        }
+        return scanWith(implementation, data, length, lines);
+    }
+
+}
@@ -1,11 +1,23 @@
 #include "rewind/parsers/HttpMessage.h"
-#include <sstream>
+#include "rewind/output/JsonWriter.h"
+#include "rewind/parsers/ContentDecoder.h"
+#include "rewind/parsers/HeaderScanner.h"
+#include "rewind/parsers/ProtocolSniffer.h"
+#include "rewind/parsers/Utf8Validator.h"
 #include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdint>
 #include <spdlog/spdlog.h>
 
 
 namespace rwd {
-    std::string getDefaultStatusMessage(int statusCode) {
+    // Text bodies up to kMaxInlineBody bytes are written out, cut to a
+    // preview when longer than kMaxBodyPreview
+    constexpr size_t kMaxInlineBody = 10000;
+    constexpr size_t kMaxBodyPreview = 500;
+
+    const char* getDefaultStatusMessage(int statusCode) {
         switch (statusCode) {
             case 200: return "OK";
             case 201: return "Created";
@@ -24,258 +36,460 @@ namespace rwd {
         }
     }
 
-    bool isValidUtf8(const std::string& str) {
-        for (size_t i = 0; i < str.length(); ) {
-            unsigned char c = str[i];
+    HttpMessage::HttpMessage()
+        : HttpMessage(std::pmr::get_default_resource())
+    {
+    }
 
-            if (c <= 0x7F) {
-                i++;
-                continue;
+    HttpMessage::HttpMessage(std::pmr::memory_resource* resource)
+        : type_(Type::Unknown)
+        , statusCode_(0)
+        , length_(0)
+        , bodyLength_(0)
+        , headers_(resource)
+        , headersIndexed_(false)
+        , headerBlockUtf8_(Utf8State::Unchecked)
+        , bodyUtf8_(Utf8State::Unchecked)
+    {
+    }
+
+    namespace {
+        // Like istream >>: skips blanks, then returns the next blank-delimited
+        // token of line starting at pos
+        std::string_view nextToken(std::string_view line, size_t& pos)
+        {
+            while (pos < line.length() && (line[pos] == ' ' || line[pos] == '\t')) {
+                pos++;
+            }
+            size_t start = pos;
+            while (pos < line.length() && line[pos] != ' ' && line[pos] != '\t') {
+                pos++;
             }
+            return line.substr(start, pos - start);
+        }
 
-            if (c >= 0xC0 && c <= 0xDF) {
-                if (i + 1 >= str.length()) return false;
-                if ((str[i + 1] & 0xC0) != 0x80) return false;
-                i += 2;
-                continue;
+        std::string_view trim(std::string_view value)
+        {
+            size_t start = value.find_first_not_of(" \t\r");
+            if (start == std::string_view::npos) {
+                return std::string_view();
             }
+            size_t end = value.find_last_not_of(" \t\r");
+            return value.substr(start, end - start + 1);
+        }
+    }
 
-            if (c >= 0xE0 && c <= 0xEF) {
-                if (i + 2 >= str.length()) return false;
-                if ((str[i + 1] & 0xC0) != 0x80) return false;
-                if ((str[i + 2] & 0xC0) != 0x80) return false;
-                i += 3;
-                continue;
+    void HttpMessage::parseStartLine(std::string_view line, size_t offset)
+    {
+        auto spanOf = [&line, offset](std::string_view part) {
+            return Span{
+                static_cast<uint32_t>(offset + (part.data() - line.data())),
+                static_cast<uint32_t>(part.length())
+            };
+        };
+
+        size_t pos = 0;
+        std::string_view part1 = nextToken(line, pos);
+        std::string_view part2 = nextToken(line, pos);
+
+        if (part1.substr(0, 5) == "HTTP/") {
+            type_ = Type::Response;
+            version_ = spanOf(part1.substr(5));
+
+            int code = 0;
+            auto result = std::from_chars(part2.data(), part2.data() + part2.length(), code);
+            statusCode_ = (result.ec == std::errc()) ? code : 0;
+
+            // The reason phrase is the rest of the line and may contain spaces
+            std::string_view reason = trim(line.substr(pos));
+            if (!reason.empty()) {
+                statusMessage_ = spanOf(reason);
             }
+        }
+        else {
+            type_ = Type::Request;
+            method_ = spanOf(part1);
+            uri_ = spanOf(part2);
 
-            if (c >= 0xF0 && c <= 0xF7) {
-                if (i + 3 >= str.length()) return false;
-                if ((str[i + 1] & 0xC0) != 0x80) return false;
-                if ((str[i + 2] & 0xC0) != 0x80) return false;
-                if ((str[i + 3] & 0xC0) != 0x80) return false;
-                i += 4;
-                continue;
+            std::string_view part3 = nextToken(line, pos);
+            if (part3.substr(0, 5) == "HTTP/") {
+                version_ = spanOf(part3.substr(5));
             }
+        }
+    }
 
-            return false;
+    void HttpMessage::indexHeaders() const
+    {
+        if (headersIndexed_) {
+            return;
         }
 
-        return true;
+        thread_local std::vector<HeaderLine> lines;
+        lines.clear();
+
+        std::string_view block = view(headerBlock_);
+        HeaderScanner::scan(block.data(), block.length(), lines);
+        buildHeaderIndex(lines, headerBlock_.offset);
     }
 
-    HttpMessage::HttpMessage()
-        : type_(Type::Unknown)
-        , statusCode_(0)
-        , length_(0)
+    void HttpMessage::buildHeaderIndex(const std::vector<HeaderLine>& lines, size_t base) const
     {
+        headersIndexed_ = true;
+        headers_.clear();
+        headers_.reserve(lines.size());
+
+        for (const auto& line : lines) {
+            // Lines without a colon (obsolete folding, garbage) are ignored
+            if (line.colon == HeaderLine::kNoColon) {
+                continue;
+            }
+
+            std::string_view value = trim(payload_->view(base + line.colon + 1, line.lineEnd - line.colon - 1));
+            uint32_t valueOffset = value.empty()
+                ? static_cast<uint32_t>(base + line.colon + 1)
+                : static_cast<uint32_t>(value.data() - payload_->data());
+
+            std::string_view name = payload_->view(base + line.lineStart, line.colon - line.lineStart);
+
+            HeaderField field;
+            field.nameId = HeaderNames::intern(name);
+            field.nameLength = static_cast<uint16_t>(std::min<size_t>(name.length(), UINT16_MAX));
+            field.nameOffset = static_cast<uint32_t>(base + line.lineStart);
+            field.value = Span{valueOffset, static_cast<uint32_t>(value.length())};
+            headers_.push_back(field);
+        }
     }
 
-    HttpMessage HttpMessage::parseFromData(const std::string& data, bool isClientToServer)
+    bool HttpMessage::isStartLine(std::string_view line)
+    {
+        return ProtocolSniffer::isStart(ProtocolSniffer::sniff(line));
+    }
+
+    HttpMessage HttpMessage::parseHead(std::shared_ptr<PayloadBuffer> payload, size_t headLength)
     {
         HttpMessage msg;
-        msg.setLength(data.length());
-
-        if (data.find("HTTP/") == std::string::npos &&
-            data.find("GET ") != 0 &&
-            data.find("POST ") != 0 &&
-            data.find("PUT ") != 0 &&
-            data.find("DELETE ") != 0 &&
-            data.find("HEAD ") != 0 &&
-            data.find("OPTIONS ") != 0 &&
-            data.find("PATCH ") != 0) {
-            return msg;
-        }
+        msg.setLength(headLength);
 
-        size_t firstLineEnd = data.find("\r\n");
-        if (firstLineEnd == std::string::npos) {
+        std::string_view head = payload->view(0, headLength);
+        size_t firstLineEnd = head.find("\r\n");
+        if (firstLineEnd == std::string_view::npos || !isStartLine(head)) {
             return msg;
         }
 
-        std::string firstLine = data.substr(0, firstLineEnd);
-        std::istringstream firstLineStream(firstLine);
-
-        std::string part1, part2, part3;
-        firstLineStream >> part1 >> part2 >> part3;
-
-        if (part1.find("HTTP/") == 0)
-        {
-            msg.setType(Type::Response);
-            msg.setVersion(part1.substr(5));
-
-            try {
-                msg.setStatusCode(std::stoi(part2));
-            }
-            catch (...) {
-                msg.setStatusCode(0);
-            }
+        msg.payload_ = std::move(payload);
+        msg.parseStartLine(head.substr(0, firstLineEnd), 0);
 
-            std::string statusMsg;
-            std::getline(firstLineStream, statusMsg);
-
-            if (!statusMsg.empty()) {
-                if (statusMsg[0] == ' ') {
-                    statusMsg = statusMsg.substr(1);
-                }
-                while (!statusMsg.empty() &&
-                    (statusMsg.back() == '\r' || statusMsg.back() == ' ')) {
-                    statusMsg.pop_back();
-                }
-            }
+        // head ends with the blank line, so the header section is everything
+        // between the start line and the final CRLFCRLF
+        size_t headersStart = firstLineEnd + 2;
+        if (headLength >= headersStart + 2) {
+            msg.headerBlock_ = Span{
+                static_cast<uint32_t>(headersStart),
+                static_cast<uint32_t>(headLength - 2 - headersStart)
+            };
+        }
+        msg.body_ = Span{static_cast<uint32_t>(headLength), 0};
 
-            if (statusMsg.empty()) {
-                statusMsg = getDefaultStatusMessage(msg.getStatusCode());
-            }
+        return msg;
+    }
 
-            msg.setStatusMessage(statusMsg);
+    std::string_view HttpMessage::getStatusMessage() const
+    {
+        if (statusMessage_.length == 0 && type_ == Type::Response) {
+            return getDefaultStatusMessage(statusCode_);
+        }
+        return view(statusMessage_);
+    }
 
+    std::string_view HttpMessage::getHeader(std::string_view name) const
+    {
+        HeaderId id = HeaderNames::find(name);
+        if (id != HeaderNames::kNotInterned) {
+            return findHeader(id);
         }
-        else {
-            msg.setType(Type::Request);
-            msg.setMethod(part1);
-            msg.setUri(part2);
-            if (part3.find("HTTP/") == 0) {
-                msg.setVersion(part3.substr(5));
+
+        // Not in the name table: either absent, or it overflowed the table
+        // and has to be compared by spelling
+        indexHeaders();
+        for (auto it = headers_.rbegin(); it != headers_.rend(); ++it) {
+            if (it->nameId == HeaderNames::kNotInterned &&
+                HeaderNames::equalsIgnoreCase(view(Span{it->nameOffset, it->nameLength}), name)) {
+                return view(it->value);
             }
         }
+        return std::string_view();
+    }
 
-        size_t headersStart = firstLineEnd + 2;
-        size_t headersEnd = data.find("\r\n\r\n", headersStart);
-
-        if (headersEnd != std::string::npos) {
-            std::string headersSection = data.substr(headersStart, headersEnd - headersStart);
-            std::istringstream headersStream(headersSection);
-            std::string line;
-
-            while (std::getline(headersStream, line)) {
-                if (!line.empty() && line.back() == '\r') {
-                    line.pop_back();
-                }
-
-                size_t colonPos = line.find(':');
-                if (colonPos != std::string::npos) {
-                    std::string name = line.substr(0, colonPos);
-                    std::string value = line.substr(colonPos + 1);
-
-                    size_t start = value.find_first_not_of(" \t");
-                    size_t end = value.find_last_not_of(" \t");
-                    if (start != std::string::npos && end != std::string::npos) {
-                        value = value.substr(start, end - start + 1);
-                    }
-
-                    msg.setHeader(name, value);
-                }
-            }
+    std::string_view HttpMessage::getHeader(HeaderName name) const
+    {
+        return findHeader(HeaderNames::id(name));
+    }
 
-            size_t bodyStart = headersEnd + 4;
-            if (bodyStart < data.length()) {
-                msg.setBody(data.substr(bodyStart));
+    std::string_view HttpMessage::findHeader(HeaderId id) const
+    {
+        indexHeaders();
+
+        // Last occurrence wins, as it did when headers were kept in a map
+        for (auto it = headers_.rbegin(); it != headers_.rend(); ++it) {
+            if (it->nameId == id) {
+                return view(it->value);
             }
         }
+        return std::string_view();
+    }
 
-        return msg;
+    size_t HttpMessage::getHeaderCount() const
+    {
+        indexHeaders();
+        return headers_.size();
     }
 
-    std::string HttpMessage::getHeader(const std::string& name) const
+    void HttpMessage::appendBody(const char* data, size_t length)
     {
-        auto it = headers_.find(name);
-        if (it != headers_.end()) {
-            return it->second;
+        if (!payload_) {
+            return;
         }
-        return "";
+
+        // Spans are 32-bit; anything beyond 4GB is counted but not kept
+        size_t room = UINT32_MAX - payload_->size();
+        size_t kept = std::min(length, room);
+
+        payload_->append(data, kept);
+        body_.length += static_cast<uint32_t>(kept);
+        bodyLength_ += length;
+        bodyUtf8_ = Utf8State::Unchecked;
     }
 
-    void HttpMessage::setHeader(const std::string& name, const std::string& value)
+    bool HttpMessage::isUtf8(Span span, Utf8State& state) const
     {
-        headers_[name] = value;
+        if (state == Utf8State::Unchecked) {
+            state = Utf8Validator::validate(view(span)) ? Utf8State::Valid : Utf8State::Invalid;
+        }
+        return state == Utf8State::Valid;
     }
 
     std::string HttpMessage::getFirstLine() const
     {
         if (type_ == Type::Request) {
-            return method_ + " " + uri_ + " HTTP/" + version_;
+            return std::string(getMethod()) + " " + std::string(getUri()) + " HTTP/" + std::string(getVersion());
         }
         else if (type_ == Type::Response) {
-            return "HTTP/" + version_ + " " + std::to_string(statusCode_) + " " + statusMessage_;
+            return "HTTP/" + std::string(getVersion()) + " " + std::to_string(statusCode_) + " " +
+                std::string(getStatusMessage());
         }
         return "";
     }
 
 
-    nlohmann::json HttpMessage::toJson() const {
+    bool HttpMessage::decodeBody(size_t maxSize, std::string& decoded, bool& truncated) const
+    {
+        ContentDecoder::Encoding encoding = ContentDecoder::parse(getHeader(HeaderName::ContentEncoding));
+        if (encoding == ContentDecoder::Encoding::Identity || !ContentDecoder::isAvailable(encoding)) {
+            return false;
+        }
+
+        return ContentDecoder::decode(encoding, getBody(), maxSize, decoded, truncated);
+    }
+
+    void HttpMessage::collectOutputHeaders(std::vector<HeaderPair>& headers) const
+    {
+        // One pass over the whole block normally settles every header;
+        // lines are only checked one by one when it fails
+        bool headersUtf8 = isUtf8(headerBlock_, headerBlockUtf8_);
+        size_t first = headers.size();
+        forEachHeader([&headers, headersUtf8](std::string_view key, std::string_view value) {
+            if (!key.empty() && !value.empty() &&
+                (headersUtf8 || (Utf8Validator::validate(key) && Utf8Validator::validate(value))))
+            {
+                headers.emplace_back(key, value);
+            }
+        });
+
+        // Repeats are rare and header counts small
+        size_t kept = first;
+        for (size_t i = first; i < headers.size(); i++) {
+            bool repeated = false;
+            for (size_t later = i + 1; later < headers.size() && !repeated; later++) {
+                repeated = headers[later].first == headers[i].first;
+            }
+            if (!repeated) {
+                headers[kept++] = headers[i];
+            }
+        }
+        headers.resize(kept);
+    }
+
+    // Body - ONLY included if it's text
+    void HttpMessage::renderBody(const BodyOptions& options, BodyOutput& output) const
+    {
+        if (bodyLength_ == 0) {
+            return;
+        }
+
+        std::string_view body = getBody();
+        output.truncated = isBodyTruncated();
+
+        std::string_view contentType = getHeader(HeaderName::ContentType);
+        bool isTextContent =
+            contentType.find("text/") != std::string_view::npos ||
+            contentType.find("application/json") != std::string_view::npos ||
+            contentType.find("application/xml") != std::string_view::npos ||
+            contentType.find("application/javascript") != std::string_view::npos;
+
+        // Only bodies that are about to be emitted are decompressed, and
+        // never past what could be emitted
+        bool truncated = false;
+        if (isTextContent && options.decompress &&
+            decodeBody(std::min(options.maxDecodedSize, kMaxInlineBody + 1), output.storage, truncated)) {
+            body = output.storage;
+            output.decoded = true;
+            if (truncated && body.length() <= kMaxInlineBody) {
+                // Cut short by maxDecodedSize rather than too long to inline
+                output.truncated = true;
+            }
+        }
+
+        output.kind = BodyOutput::Kind::Type;
+        output.text = contentType.empty() ? std::string_view("unknown") : contentType;
+
+        if (!body.empty() && isTextContent && body.length() <= kMaxInlineBody) {
+            if (!(output.decoded ? Utf8Validator::validate(body) : isUtf8(body_, bodyUtf8_))) {
+                output.text = "binary";
+            }
+            else if (body.length() > kMaxBodyPreview) {
+                std::string preview = std::string(body.substr(0, kMaxBodyPreview)) + "...";
+                output.storage = std::move(preview);
+                output.kind = BodyOutput::Kind::Preview;
+                output.text = output.storage;
+            }
+            else {
+                output.kind = BodyOutput::Kind::Text;
+                output.text = body;
+            }
+        }
+    }
+
+    nlohmann::json HttpMessage::toJson(const BodyOptions& options) const {
         nlohmann::json j = nlohmann::json::object();
 
+        // Owning strings are only created here, when the message is written out
+        std::string_view method = getMethod();
+        std::string_view uri = getUri();
+        std::string_view version = getVersion();
+
         // Type
         if (type_ == Type::Request)
         {
             j["type"] = "request";
-            if (!method_.empty()) j["method"] = method_;
-            if (!uri_.empty()) j["uri"] = uri_;
+            if (!method.empty()) j["method"] = std::string(method);
+            if (!uri.empty()) j["uri"] = std::string(uri);
         }
         else if (type_ == Type::Response)
         {
             j["type"] = "response";
             j["statusCode"] = statusCode_;
-            if (!statusMessage_.empty()) j["statusMessage"] = statusMessage_;
+            std::string_view statusMessage = getStatusMessage();
+            if (!statusMessage.empty()) j["statusMessage"] = std::string(statusMessage);
         }
 
         // Version
-        if (!version_.empty()) {
-            j["version"] = version_;
+        if (!version.empty()) {
+            j["version"] = std::string(version);
         }
 
         j["length"] = static_cast<int>(length_);
 
         // Headers
-        nlohmann::json headersObj = nlohmann::json::object();
-        for (const auto& [key, value] : headers_)
-        {
-            if (!key.empty() && !value.empty())
-            {
-                if (isValidUtf8(value))
-                {
-                    headersObj[key] = value;
-                }
+        std::vector<HeaderPair> headers;
+        collectOutputHeaders(headers);
+        if (!headers.empty()) {
+            nlohmann::json headersObj = nlohmann::json::object();
+            for (const auto& [key, value] : headers) {
+                headersObj[std::string(key)] = std::string(value);
             }
-        }
-        if (!headersObj.empty()) {
             j["headers"] = headersObj;
         }
 
-        // Body - ONLY include if it's text
-        if (!body_.empty()) {
-            j["bodyLength"] = body_.length();
+        BodyOutput body;
+        renderBody(options, body);
+        if (body.kind != BodyOutput::Kind::None) {
+            j["bodyLength"] = bodyLength_;
+            if (body.truncated) {
+                j["bodyTruncated"] = true;
+            }
+            if (isBodyTruncated()) {
+                // Only the first body_.length bytes were captured
+                j["capturedBodyLength"] = body_.length;
+            }
+            if (body.decoded) {
+                j["bodyDecoded"] = true;
+            }
 
-            std::string contentType = getHeader("Content-Type");
-            bool isTextContent =
-                contentType.find("text/") != std::string::npos ||
-                contentType.find("application/json") != std::string::npos ||
-                contentType.find("application/xml") != std::string::npos ||
-                contentType.find("application/javascript") != std::string::npos;
+            switch (body.kind) {
+            case BodyOutput::Kind::Text: j["body"] = std::string(body.text); break;
+            case BodyOutput::Kind::Preview: j["bodyPreview"] = std::string(body.text); break;
+            default: j["bodyType"] = std::string(body.text); break;
+            }
+        }
 
-            if (isTextContent && body_.length() <= 10000)
-            {
-                if (isValidUtf8(body_))
-                {
-                    if (body_.length() > 500)
-                    {
-                        j["bodyPreview"] = body_.substr(0, 500) + "...";
-                    }
-                    else
-                    {
-                        j["body"] = body_;
-                    }
-                }
-                else
-                {
-                    j["bodyType"] = "binary";
-                }
+        return j;
+    }
+
+    void HttpMessage::writeJson(JsonWriter& writer, const BodyOptions& options) const
+    {
+        writer.beginObject();
+
+        if (type_ == Type::Request) {
+            writer.field("type", "request");
+            if (!getMethod().empty()) writer.field("method", getMethod());
+            if (!getUri().empty()) writer.field("uri", getUri());
+        }
+        else if (type_ == Type::Response) {
+            writer.field("type", "response");
+            writer.field("statusCode", statusCode_);
+            std::string_view statusMessage = getStatusMessage();
+            if (!statusMessage.empty()) writer.field("statusMessage", statusMessage);
+        }
+
+        if (!getVersion().empty()) {
+            writer.field("version", getVersion());
+        }
+
+        writer.field("length", static_cast<int>(length_));
+
+        thread_local std::vector<HeaderPair> headers;
+        headers.clear();
+        collectOutputHeaders(headers);
+        if (!headers.empty()) {
+            writer.key("headers");
+            writer.beginObject();
+            for (const auto& [key, value] : headers) {
+                writer.field(key, value);
             }
-            else
-            {
-                j["bodyType"] = contentType.empty() ? "unknown" : contentType;
+            writer.endObject();
+        }
+
+        BodyOutput body;
+        renderBody(options, body);
+        if (body.kind != BodyOutput::Kind::None) {
+            writer.field("bodyLength", bodyLength_);
+            if (body.truncated) {
+                writer.field("bodyTruncated", true);
+            }
+            if (isBodyTruncated()) {
+                writer.field("capturedBodyLength", body_.length);
+            }
+            if (body.decoded) {
+                writer.field("bodyDecoded", true);
+            }
+
+            switch (body.kind) {
+            case BodyOutput::Kind::Text: writer.field("body", body.text); break;
+            case BodyOutput::Kind::Preview: writer.field("bodyPreview", body.text); break;
+            default: writer.field("bodyType", body.text); break;
             }
         }
 
-        return j;
+        writer.endObject();
     }
 }
@@ -0,0 +1,383 @@
+#include "rewind/parsers/HttpStreamParser.h"
+#include "rewind/parsers/HeaderNames.h"
+#include "rewind/parsers/ProtocolSniffer.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace rwd {
+
+    namespace {
+        // Header blocks larger than this are treated as garbage and dropped
+        constexpr size_t kMaxHeadSize = 64 * 1024;
+        constexpr size_t kMaxChunkLineSize = 1024;
+        // A larger size line is garbage, not a chunk to wait for
+        constexpr size_t kMaxChunkSize = size_t(1) << 32;
+        // Requests awaiting a response beyond this are not pipelining but a
+        // response direction that is not HTTP; the oldest are forgotten
+        constexpr size_t kMaxPendingResponses = 128;
+
+        bool isChunked(const HttpMessage& msg)
+        {
+            // Only the last transfer coding frames the body (RFC 9112 6.1):
+            // "gzip, chunked" is chunked, "chunked, gzip" is not
+            std::string_view te = msg.getHeader(HeaderName::TransferEncoding);
+            size_t comma = te.rfind(',');
+            std::string_view last = comma == std::string_view::npos ? te : te.substr(comma + 1);
+            last = last.substr(0, std::min(last.find(';'), last.size()));
+
+            size_t begin = last.find_first_not_of(" \t");
+            if (begin == std::string_view::npos) {
+                return false;
+            }
+            size_t end = last.find_last_not_of(" \t");
+            return HeaderNames::equalsIgnoreCase(last.substr(begin, end - begin + 1), "chunked");
+        }
+
+        bool parseContentLength(const HttpMessage& msg, size_t& length)
+        {
+            std::string_view cl = msg.getHeader(HeaderName::ContentLength);
+            if (cl.empty()) {
+                return false;
+            }
+
+            // The whole value must be digits: "12abc" is not 12
+            auto result = std::from_chars(cl.data(), cl.data() + cl.length(), length);
+            return result.ec == std::errc() && result.ptr == cl.data() + cl.length();
+        }
+
+        bool parseChunkSize(const std::string& line, size_t& size)
+        {
+            // chunk-size [ ; chunk-ext ]. from_chars takes no sign or "0x"
+            // prefix, and the whole token must be hex digits.
+            size_t end = std::min(line.find_first_of(";\r\n \t"), line.size());
+            if (end == 0) {
+                return false;
+            }
+
+            auto result = std::from_chars(line.data(), line.data() + end, size, 16);
+            return result.ec == std::errc() && result.ptr == line.data() + end && size <= kMaxChunkSize;
+        }
+    }
+
+    HttpStreamParser::HttpStreamParser(const BodyLimits& limits)
+        : state_(State::Head)
+        , headLines_(0)
+        , discarding_(false)
+        , bodyRemaining_(0)
+        , bodyLimit_(0)
+        , messageLength_(0)
+    {
+        setBodyLimits(limits);
+    }
+
+    void HttpStreamParser::setBodyLimits(const BodyLimits& limits)
+    {
+        bodyLimit_ = limits.captureBody ? limits.maxBodySize : 0;
+    }
+
+    void HttpStreamParser::appendBody(const char* data, size_t length)
+    {
+        // Past the limit only the length is tracked, so a multi-gigabyte
+        // download costs no more memory than its first maxBodySize bytes
+        size_t kept = message_.getBody().length();
+        size_t room = bodyLimit_ > kept ? bodyLimit_ - kept : 0;
+        size_t n = std::min(length, room);
+
+        message_.appendBody(data, n);
+        message_.skipBody(length - n);
+    }
+
+    void HttpStreamParser::reset()
+    {
+        state_ = State::Head;
+        payload_.reset();
+        headLines_ = 0;
+        discarding_ = false;
+        line_.clear();
+        message_ = HttpMessage();
+        bodyRemaining_ = 0;
+        messageLength_ = 0;
+    }
+
+    void HttpStreamParser::expectResponse(std::string_view method)
+    {
+        if (pendingResponses_.size() >= kMaxPendingResponses) {
+            pendingResponses_.pop_front();
+        }
+
+        Expected expected = Expected::Normal;
+        if (method == "HEAD") {
+            expected = Expected::Bodiless;
+        }
+        else if (method == "CONNECT") {
+            expected = Expected::Tunnel;
+        }
+        pendingResponses_.push_back(expected);
+    }
+
+    void HttpStreamParser::feed(const char* data, size_t length, const MessageHandler& onMessage)
+    {
+        size_t offset = 0;
+
+        while (offset < length) {
+            const char* p = data + offset;
+            size_t available = length - offset;
+
+            switch (state_) {
+            case State::Head:
+                offset += consumeHead(p, available, onMessage);
+                break;
+
+            case State::Body:
+            case State::ChunkData: {
+                // Framed body bytes are copied through without being scanned
+                size_t n = std::min(available, bodyRemaining_);
+                appendBody(p, n);
+                bodyRemaining_ -= n;
+                messageLength_ += n;
+                offset += n;
+
+                if (bodyRemaining_ == 0) {
+                    if (state_ == State::Body) {
+                        complete(onMessage);
+                    } else {
+                        state_ = State::ChunkDataEnd;
+                    }
+                }
+                break;
+            }
+
+            case State::ChunkSize:
+            case State::ChunkDataEnd:
+            case State::Trailers: {
+                bool lineComplete = false;
+                size_t n = consumeLine(p, available, lineComplete);
+                // Chunk framing and trailers count towards the wire length
+                // but are not part of the body
+                messageLength_ += n;
+                offset += n;
+
+                if (!lineComplete) {
+                    if (line_.size() > kMaxChunkLineSize) {
+                        spdlog::debug("Chunk framing line too long, resynchronising");
+                        reset();
+                    }
+                    break;
+                }
+
+                std::string line;
+                line.swap(line_);
+                while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+                    line.pop_back();
+                }
+
+                if (state_ == State::ChunkDataEnd) {
+                    state_ = State::ChunkSize;
+                }
+                else if (state_ == State::ChunkSize) {
+                    size_t chunkSize = 0;
+                    if (!parseChunkSize(line, chunkSize)) {
+                        spdlog::debug("Invalid chunk size line, resynchronising");
+                        reset();
+                    }
+                    else if (chunkSize == 0) {
+                        state_ = State::Trailers;
+                    }
+                    else {
+                        bodyRemaining_ = chunkSize;
+                        state_ = State::ChunkData;
+                    }
+                }
+                else if (line.empty()) {
+                    complete(onMessage);
+                }
+                break;
+            }
+
+            case State::UntilClose:
+                appendBody(p, available);
+                messageLength_ += available;
+                offset = length;
+                break;
+            }
+        }
+    }
+
+    size_t HttpStreamParser::consumeHead(const char* data, size_t length, const MessageHandler& onMessage)
+    {
+        size_t consumed = 0;
+
+        while (consumed < length) {
+            const char* start = data + consumed;
+            const char* newline = static_cast<const char*>(std::memchr(start, '\n', length - consumed));
+            size_t n = newline ? static_cast<size_t>(newline - start + 1) : length - consumed;
+
+            if (!discarding_ && headLines_ == 0 && (!payload_ || payload_->empty())) {
+                // At a message boundary a short prefix tells whether this
+                // line can start a message; if not it is never copied
+                ProtocolSniffer::Result kind = ProtocolSniffer::sniff(start, length - consumed);
+                discarding_ = (kind == ProtocolSniffer::Result::Continuation ||
+                    kind == ProtocolSniffer::Result::NotHttp ||
+                    kind == ProtocolSniffer::Result::Binary);
+            }
+
+            if (discarding_) {
+                consumed += n;
+                discarding_ = (newline == nullptr);
+                continue;
+            }
+
+            if (!payload_) {
+                payload_ = PayloadBuffer::acquire();
+            }
+            payload_->append(start, n);
+            consumed += n;
+
+            if (!newline) {
+                break;
+            }
+
+            std::string_view head = payload_->view();
+            if (headLines_ == 0) {
+                // Empty lines between messages are allowed; anything that is
+                // not a start line means we joined mid-message, so drop it
+                if (head == "\r\n" || head == "\n" || !HttpMessage::isStartLine(head)) {
+                    payload_->clear();
+                    continue;
+                }
+            }
+            headLines_++;
+
+            size_t size = head.size();
+            if (size >= 4 && head.substr(size - 4) == "\r\n\r\n") {
+                // The message shares the buffer; body bytes are appended to it
+                message_ = HttpMessage::parseHead(payload_, size);
+                messageLength_ = size;
+                headLines_ = 0;
+                beginBody(onMessage);
+                return consumed;
+            }
+        }
+
+        if (payload_ && payload_->size() > kMaxHeadSize) {
+            spdlog::debug("Header block exceeds {} bytes, resynchronising", kMaxHeadSize);
+            payload_->clear();
+            headLines_ = 0;
+        }
+
+        return consumed;
+    }
+
+    size_t HttpStreamParser::consumeLine(const char* data, size_t length, bool& complete)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(data, '\n', length));
+        size_t n = newline ? static_cast<size_t>(newline - data + 1) : length;
+
+        line_.append(data, n);
+        complete = (newline != nullptr);
+        return n;
+    }
+
+    void HttpStreamParser::beginBody(const MessageHandler& onMessage)
+    {
+        if (!message_.isValid()) {
+            reset();
+            return;
+        }
+
+        bool isResponse = message_.getType() == HttpMessage::Type::Response;
+        int status = message_.getStatusCode();
+
+        if (isResponse && status >= 100 && status < 200 && status != 101) {
+            // Interim responses (100 Continue, 103 Early Hints) precede the
+            // real response and are not recorded
+            reset();
+            return;
+        }
+
+        bool bodiless = false;
+        if (isResponse && !pendingResponses_.empty()) {
+            Expected expected = pendingResponses_.front();
+            pendingResponses_.pop_front();
+            // A refused CONNECT keeps its normal framing
+            bodiless = expected == Expected::Bodiless ||
+                (expected == Expected::Tunnel && status >= 200 && status < 300);
+        }
+
+        if (isResponse && (bodiless || status == 101 || status == 204 || status == 304)) {
+            complete(onMessage);
+            return;
+        }
+
+        if (isChunked(message_)) {
+            state_ = State::ChunkSize;
+            return;
+        }
+
+        size_t contentLength = 0;
+        if (parseContentLength(message_, contentLength)) {
+            if (contentLength == 0) {
+                complete(onMessage);
+            } else {
+                bodyRemaining_ = contentLength;
+                state_ = State::Body;
+            }
+            return;
+        }
+
+        if (isResponse) {
+            state_ = State::UntilClose;
+        } else {
+            complete(onMessage);
+        }
+    }
+
+    void HttpStreamParser::complete(const MessageHandler& onMessage)
+    {
+        message_.setLength(messageLength_);
+        onMessage(std::move(message_));
+        reset();
+    }
+
+    void HttpStreamParser::skip(size_t length, const MessageHandler& onMessage)
+    {
+        if ((state_ == State::Body || state_ == State::ChunkData) && length <= bodyRemaining_) {
+            // Lost body bytes only shorten the recorded body; framing is intact
+            bodyRemaining_ -= length;
+            messageLength_ += length;
+            message_.skipBody(length);
+
+            if (bodyRemaining_ == 0) {
+                if (state_ == State::Body) {
+                    complete(onMessage);
+                } else {
+                    state_ = State::ChunkDataEnd;
+                }
+            }
+            return;
+        }
+
+        if (state_ == State::UntilClose) {
+            messageLength_ += length;
+            message_.skipBody(length);
+            return;
+        }
+
+        reset();
+    }
+
+    void HttpStreamParser::finish(const MessageHandler& onMessage)
+    {
+        if (state_ != State::Head && message_.isValid()) {
+            // Close-delimited bodies end here; a truncated framed body is
+            // still better recorded than lost
+            complete(onMessage);
+            return;
+        }
+
+        reset();
+    }
+
+}
@@ -0,0 +1,114 @@
+#include "rewind/parsers/PayloadBuffer.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace rwd {
+
+    namespace {
+        struct Pool {
+            std::mutex mutex;
+            std::vector<PayloadBuffer*> free;
+            // Enough to cover the in-flight messages of a busy agent without
+            // holding on to memory after a burst
+            size_t maxBuffers = 1024;
+            // Buffers that grew past this (large bodies) are freed, not recycled
+            size_t maxCapacity = 64 * 1024;
+
+            std::atomic<size_t> hits{0};
+            std::atomic<size_t> misses{0};
+            std::atomic<size_t> discarded{0};
+
+            ~Pool() {
+                for (auto* buffer : free) {
+                    delete buffer;
+                }
+            }
+        };
+
+        Pool& pool()
+        {
+            static Pool instance;
+            return instance;
+        }
+    }
+
+    std::shared_ptr<PayloadBuffer> PayloadBuffer::acquire()
+    {
+        Pool& p = pool();
+        PayloadBuffer* buffer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            if (!p.free.empty()) {
+                buffer = p.free.back();
+                p.free.pop_back();
+            }
+        }
+
+        if (buffer) {
+            p.hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            p.misses.fetch_add(1, std::memory_order_relaxed);
+            buffer = new PayloadBuffer();
+        }
+
+        return std::shared_ptr<PayloadBuffer>(buffer, &PayloadBuffer::release);
+    }
+
+    void PayloadBuffer::release(PayloadBuffer* buffer)
+    {
+        Pool& p = pool();
+        {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            if (buffer->bytes_.capacity() <= p.maxCapacity && p.free.size() < p.maxBuffers) {
+                buffer->bytes_.clear();
+                p.free.push_back(buffer);
+                return;
+            }
+        }
+
+        p.discarded.fetch_add(1, std::memory_order_relaxed);
+        delete buffer;
+    }
+
+    void PayloadBuffer::configurePool(size_t maxBuffers, size_t maxCapacity)
+    {
+        Pool& p = pool();
+        std::vector<PayloadBuffer*> excess;
+        {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            p.maxBuffers = maxBuffers;
+            p.maxCapacity = maxCapacity;
+
+            auto keep = std::partition(p.free.begin(), p.free.end(), [maxCapacity](PayloadBuffer* buffer) {
+                return buffer->bytes_.capacity() <= maxCapacity;
+            });
+            excess.assign(keep, p.free.end());
+            p.free.erase(keep, p.free.end());
+
+            while (p.free.size() > maxBuffers) {
+                excess.push_back(p.free.back());
+                p.free.pop_back();
+            }
+        }
+
+        for (auto* buffer : excess) {
+            delete buffer;
+        }
+    }
+
+    PayloadBuffer::PoolStats PayloadBuffer::getPoolStats()
+    {
+        Pool& p = pool();
+        PoolStats stats;
+        stats.hits = p.hits.load(std::memory_order_relaxed);
+        stats.misses = p.misses.load(std::memory_order_relaxed);
+        stats.discarded = p.discarded.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(p.mutex);
+        stats.pooled = p.free.size();
+        return stats;
+    }
+
+}
@@ -0,0 +1,134 @@
+#include "rewind/parsers/ProtocolSniffer.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+
+namespace rwd {
+
+    namespace {
+        constexpr std::string_view kMethods[] = {
+            // RFC 9110
+            "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE",
+            // RFC 5789
+            "PATCH",
+            // WebDAV (RFC 4918) and its extensions (RFC 3253, 3648, 3744, 4437, 4791, 5323, 5842)
+            "PROPFIND", "PROPPATCH", "MKCOL", "COPY", "MOVE", "LOCK", "UNLOCK",
+            "VERSION-CONTROL", "REPORT", "CHECKOUT", "CHECKIN", "UNCHECKOUT",
+            "MKWORKSPACE", "UPDATE", "LABEL", "MERGE", "BASELINE-CONTROL", "MKACTIVITY",
+            "ORDERPATCH", "ACL", "MKREDIRECTREF", "UPDATEREDIRECTREF", "MKCALENDAR",
+            "SEARCH", "BIND", "UNBIND", "REBIND"
+        };
+
+        constexpr size_t kMethodCount = std::size(kMethods);
+        static_assert(kMethodCount <= 64, "method index is a 64-bit mask");
+
+        // For every possible first byte, the set of methods starting with it
+        constexpr std::array<uint64_t, 256> buildFirstByteIndex()
+        {
+            std::array<uint64_t, 256> index{};
+            for (size_t i = 0; i < kMethodCount; i++) {
+                index[static_cast<unsigned char>(kMethods[i][0])] |= uint64_t(1) << i;
+            }
+            return index;
+        }
+
+        constexpr auto kMethodsByFirstByte = buildFirstByteIndex();
+
+        constexpr size_t longestMethod()
+        {
+            size_t longest = 0;
+            for (auto method : kMethods) {
+                longest = std::max(longest, method.length());
+            }
+            return longest;
+        }
+
+        static_assert(longestMethod() + 1 == ProtocolSniffer::kPrefixLength,
+            "kPrefixLength must cover the longest method and its trailing space");
+
+        bool isTlsRecord(const unsigned char* bytes, size_t length)
+        {
+            // ContentType 20-24 followed by major version 3 (SSL 3.0 to TLS 1.3)
+            return length >= 2 && bytes[0] >= 0x14 && bytes[0] <= 0x18 && bytes[1] == 0x03;
+        }
+    }
+
+    ProtocolSniffer::Result ProtocolSniffer::sniff(const char* data, size_t length)
+    {
+        if (length == 0) {
+            return Result::Incomplete;
+        }
+
+        length = std::min(length, kPrefixLength);
+        std::string_view prefix(data, length);
+        bool incomplete = false;
+
+        // Status line
+        constexpr std::string_view kHttp = "HTTP/";
+        if (length >= kHttp.length()) {
+            if (prefix.substr(0, kHttp.length()) == kHttp) {
+                return Result::ResponseStart;
+            }
+        }
+        else if (kHttp.substr(0, length) == prefix) {
+            incomplete = true;
+        }
+
+        // Request line: only methods sharing the first byte are compared
+        uint64_t candidates = kMethodsByFirstByte[static_cast<unsigned char>(data[0])];
+        while (candidates) {
+            size_t i = static_cast<size_t>(std::countr_zero(candidates));
+            candidates &= candidates - 1;
+
+            std::string_view method = kMethods[i];
+            if (length > method.length()) {
+                if (prefix.substr(0, method.length()) == method && prefix[method.length()] == ' ') {
+                    return Result::RequestStart;
+                }
+            }
+            else if (method.substr(0, length) == prefix) {
+                incomplete = true;
+            }
+        }
+
+        if (incomplete) {
+            return Result::Incomplete;
+        }
+
+        const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+        if (isTlsRecord(bytes, length)) {
+            return Result::NotHttp;
+        }
+
+        // Header and text body bytes are printable; control bytes mean a
+        // binary protocol or a binary body, which only the caller can tell apart
+        for (size_t i = 0; i < length; i++) {
+            unsigned char c = bytes[i];
+            if ((c < 0x20 && c != '\t' && c != '\r' && c != '\n') || c == 0x7F) {
+                return Result::Binary;
+            }
+        }
+
+        return Result::Continuation;
+    }
+
+    bool ProtocolSniffer::isKnownMethod(std::string_view token)
+    {
+        if (token.empty()) {
+            return false;
+        }
+
+        uint64_t candidates = kMethodsByFirstByte[static_cast<unsigned char>(token[0])];
+        while (candidates) {
+            size_t i = static_cast<size_t>(std::countr_zero(candidates));
+            candidates &= candidates - 1;
+            if (kMethods[i] == token) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,46 @@
+#include "rewind/parsers/SimdLevel.h"
+
+namespace rwd {
+
+    SimdLevel detectSimdLevel()
+    {
+        static const SimdLevel best = [] {
+            if (isSimdLevelSupported(SimdLevel::Avx2)) {
+                return SimdLevel::Avx2;
+            }
+            if (isSimdLevelSupported(SimdLevel::Sse42)) {
+                return SimdLevel::Sse42;
+            }
+            return SimdLevel::Scalar;
+        }();
+        return best;
+    }
+
+    bool isSimdLevelSupported(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Scalar:
+            return true;
+#ifdef REWIND_X86_SIMD
+        case SimdLevel::Sse42:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2");
+        case SimdLevel::Avx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    const char* simdLevelName(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Sse42: return "sse4.2";
+        case SimdLevel::Avx2: return "avx2";
+        default: return "scalar";
+        }
+    }
+
+}
@@ -0,0 +1,160 @@
+#include "rewind/parsers/Utf8Validator.h"
+#include <cstdint>
+#include <cstring>
+
+#ifdef REWIND_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace rwd {
+
+    namespace {
+        constexpr size_t kInvalid = static_cast<size_t>(-1);
+
+        // Checks the multi-byte sequence starting at s[i] (which is >= 0x80)
+        // and returns the offset past it, or kInvalid
+        inline size_t checkSequence(const unsigned char* s, size_t i, size_t length)
+        {
+            unsigned char lead = s[i];
+            size_t size;
+            unsigned char low = 0x80;
+            unsigned char high = 0xBF;
+
+            if (lead >= 0xC2 && lead <= 0xDF) {
+                size = 2;
+            } else if (lead >= 0xE0 && lead <= 0xEF) {
+                size = 3;
+                if (lead == 0xE0) low = 0xA0;        // overlong
+                else if (lead == 0xED) high = 0x9F;  // surrogates
+            } else if (lead >= 0xF0 && lead <= 0xF4) {
+                size = 4;
+                if (lead == 0xF0) low = 0x90;        // overlong
+                else if (lead == 0xF4) high = 0x8F;  // past U+10FFFF
+            } else {
+                return kInvalid;
+            }
+
+            if (length - i < size || s[i + 1] < low || s[i + 1] > high) {
+                return kInvalid;
+            }
+            for (size_t k = 2; k < size; k++) {
+                if ((s[i + k] & 0xC0) != 0x80) {
+                    return kInvalid;
+                }
+            }
+            return i + size;
+        }
+
+        // Validates s[i, end), letting the last sequence run past end (but
+        // not past length). Returns where it stopped, or kInvalid.
+        inline size_t checkRange(const unsigned char* s, size_t i, size_t end, size_t length)
+        {
+            while (i < end) {
+                if (s[i] < 0x80) {
+                    i++;
+                    continue;
+                }
+                i = checkSequence(s, i, length);
+                if (i == kInvalid) {
+                    return kInvalid;
+                }
+            }
+            return i;
+        }
+
+        // checkRange, skipping eight ASCII bytes at a time
+        inline size_t checkWords(const unsigned char* s, size_t i, size_t end, size_t length)
+        {
+            while (i + 8 <= end) {
+                uint64_t word;
+                std::memcpy(&word, s + i, sizeof(word));
+                if ((word & 0x8080808080808080ULL) == 0) {
+                    i += 8;
+                    continue;
+                }
+                i = checkRange(s, i, i + 8, length);
+                if (i == kInvalid) {
+                    return kInvalid;
+                }
+            }
+            return checkRange(s, i, end, length);
+        }
+
+        bool validateScalar(const unsigned char* s, size_t length)
+        {
+            return checkWords(s, 0, length, length) != kInvalid;
+        }
+
+#ifdef REWIND_X86_SIMD
+        // Both vector paths test a whole block for high bits at once. A block
+        // that has any is checked as the scalar path would up to its end, so
+        // mixed text costs at most one vector test per block.
+        __attribute__((target("sse4.2")))
+        bool validateSse42(const unsigned char* s, size_t length)
+        {
+            size_t i = 0;
+            while (i + 32 <= length) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 16));
+                if (_mm_movemask_epi8(_mm_or_si128(a, b)) == 0) {
+                    i += 32;
+                    continue;
+                }
+                i = checkWords(s, i, i + 32, length);
+                if (i == kInvalid) {
+                    return false;
+                }
+            }
+            return checkWords(s, i, length, length) != kInvalid;
+        }
+
+        __attribute__((target("avx2")))
+        bool validateAvx2(const unsigned char* s, size_t length)
+        {
+            size_t i = 0;
+            while (i + 64 <= length) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + 32));
+                if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) == 0) {
+                    i += 64;
+                    continue;
+                }
+                i = checkWords(s, i, i + 64, length);
+                if (i == kInvalid) {
+                    return false;
+                }
+            }
+            return checkWords(s, i, length, length) != kInvalid;
+        }
+#endif
+
+        bool validateWith(Utf8Validator::Implementation implementation, std::string_view data)
+        {
+            const unsigned char* s = reinterpret_cast<const unsigned char*>(data.data());
+            switch (implementation) {
+#ifdef REWIND_X86_SIMD
+            case Utf8Validator::Implementation::Avx2:
+                return validateAvx2(s, data.length());
+            case Utf8Validator::Implementation::Sse42:
+                return validateSse42(s, data.length());
+#endif
+            default:
+                return validateScalar(s, data.length());
+            }
+        }
+    }
+
+    bool Utf8Validator::validate(std::string_view data)
+    {
+        return validateWith(detectSimdLevel(), data);
+    }
+
+    bool Utf8Validator::validate(std::string_view data, Implementation implementation)
+    {
+        if (!isSimdLevelSupported(implementation)) {
+            implementation = Implementation::Scalar;
+        }
+        return validateWith(implementation, data);
+    }
+
+}
@@ -0,0 +1,235 @@
+// rewind-dump: turn binary session segments (output_format: segment) back
+// into the JSON the other output formats write, or summarise them without
+// decoding every column. With a time range, the segment sidecar indexes
+// decide which segments (and blocks) are opened at all.
+
+#include "rewind/output/SegmentIndex.h"
+#include "rewind/output/SegmentReader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+    void printUsage(const char* programName) {
+        std::cout << "Usage: " << programName << " [options] <segment|directory> ...\n"
+                  << "Options:\n"
+                  << "  -o, --output <file>  Write the sessions to <file> (default: stdout)\n"
+                  << "  --ndjson             One session per line instead of one JSON document\n"
+                  << "  --blocks             List each block's offset, size, sessions and time range\n"
+                  << "  --latency            Transaction latency percentiles, from the timing column only\n"
+                  << "  --from <time>        Only sessions still open at or after <time>\n"
+                  << "  --to <time>          Only sessions started at or before <time>\n"
+                  << "                       (--blocks and --latency apply the range per block)\n"
+                  << "  --help               Show this help message\n"
+                  << "A directory stands for all the segments in it. <time> is seconds since\n"
+                  << "the epoch or a UTC date and time: 2026-10-16T14:02[:00]\n";
+    }
+
+    // Microseconds since the epoch, as in the segment
+    bool parseTime(const std::string& text, int64_t& micros) {
+        char* end = nullptr;
+        double seconds = std::strtod(text.c_str(), &end);
+        if (end != text.c_str() && *end == '\0') {
+            micros = std::llround(seconds * 1e6);
+            return true;
+        }
+
+        int year = 0;
+        unsigned month = 0;
+        unsigned day = 0;
+        char separator = 0;
+        int hour = 0;
+        int minute = 0;
+        double second = 0;
+        int fields = std::sscanf(text.c_str(), "%d-%u-%u%c%d:%d:%lf",
+            &year, &month, &day, &separator, &hour, &minute, &second);
+        std::chrono::year_month_day date{std::chrono::year(year), std::chrono::month(month), std::chrono::day(day)};
+        if (fields < 6 || (separator != 'T' && separator != ' ') || !date.ok()) {
+            return false;
+        }
+
+        auto days = std::chrono::sys_days(date).time_since_epoch();
+        micros = std::chrono::duration_cast<std::chrono::microseconds>(days).count() +
+            (hour * 3600LL + minute * 60LL) * 1000000 + std::llround(second * 1e6);
+        return true;
+    }
+
+    // The segments of a directory, oldest first (their names start with the
+    // time they were started)
+    bool listSegments(const std::string& directory, std::vector<std::string>& segments) {
+        std::vector<std::filesystem::path> found;
+        try {
+            for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".rwseg") {
+                    found.push_back(entry.path());
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Failed to list " << directory << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        // By stem, so that a -1 suffix comes after the name it was added to
+        std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+            return a.stem() < b.stem();
+        });
+        for (const auto& path : found) {
+            segments.push_back(path.string());
+        }
+        return true;
+    }
+
+    double percentile(const std::vector<int64_t>& sorted, double fraction) {
+        size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+        return sorted[index] / 1000.0;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string outputPath;
+    std::vector<std::string> inputs;
+    bool ndjson = false;
+    bool listBlocks = false;
+    bool latency = false;
+    int64_t from = std::numeric_limits<int64_t>::min();
+    int64_t to = std::numeric_limits<int64_t>::max();
+    bool ranged = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--ndjson") {
+            ndjson = true;
+        } else if (arg == "--blocks") {
+            listBlocks = true;
+        } else if (arg == "--latency") {
+            latency = true;
+        } else if ((arg == "--from" || arg == "--to") && i + 1 < argc) {
+            if (!parseTime(argv[++i], arg == "--from" ? from : to)) {
+                std::cerr << "Invalid time for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+            ranged = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else if (std::filesystem::is_directory(arg)) {
+            if (!listSegments(arg, inputs)) {
+                return 1;
+            }
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = outputPath.empty() ? std::cout : file;
+
+    std::vector<int64_t> durations;
+    size_t sessionCount = 0;
+    size_t opened = 0;
+    bool dumping = !listBlocks && !latency;
+    if (dumping && !ndjson) {
+        out << "{\"sessions\":[\n";
+    }
+
+    for (const auto& input : inputs) {
+        // Segments without a sidecar are opened and checked block by block
+        rwd::SegmentIndex index;
+        if (ranged && rwd::readSegmentIndex(rwd::segmentIndexPath(input), index) && !index.overlaps(from, to)) {
+            continue;
+        }
+
+        rwd::SegmentReader reader;
+        if (!reader.open(input)) {
+            return 1;
+        }
+        opened++;
+
+        const auto& blocks = reader.getBlocks();
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i].firstStart > to || blocks[i].lastEnd < from) {
+                continue;
+            }
+
+            if (listBlocks) {
+                char line[160];
+                std::snprintf(line, sizeof(line), "%s block %zu: offset %llu, %u bytes, %u sessions, %.6f - %.6f\n",
+                    input.c_str(), i, static_cast<unsigned long long>(blocks[i].offset), blocks[i].length,
+                    blocks[i].sessionCount, blocks[i].firstStart / 1e6, blocks[i].lastEnd / 1e6);
+                out << line;
+            }
+
+            if (latency && !reader.readDurations(i, durations)) {
+                return 1;
+            }
+
+            if (dumping) {
+                bool ok = reader.readSessions(i, [&](std::string_view session) {
+                    if (!ndjson && sessionCount > 0) {
+                        out << ",\n";
+                    }
+                    out << session << '\n';
+                    sessionCount++;
+                }, from, to);
+                if (!ok) {
+                    return 1;
+                }
+            }
+        }
+    }
+
+    if (dumping && !ndjson) {
+        out << "],\"sessionCount\":" << sessionCount << "}\n";
+    }
+    if (ranged) {
+        std::cerr << "Opened " << opened << " of " << inputs.size() << " segments" << std::endl;
+    }
+
+    if (latency) {
+        if (durations.empty()) {
+            out << "No complete transactions\n";
+        } else {
+            std::sort(durations.begin(), durations.end());
+            char line[160];
+            std::snprintf(line, sizeof(line), "%zu transactions, ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+                durations.size(), percentile(durations, 0.5), percentile(durations, 0.9),
+                percentile(durations, 0.99), durations.back() / 1000.0);
+            out << line;
+        }
+    }
+
+    if (!out) {
+        std::cerr << "Failed to write output" << std::endl;
+        return 1;
+    }
+    return 0;
+}
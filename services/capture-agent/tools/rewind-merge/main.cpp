@@ -0,0 +1,178 @@
+// rewind-merge: stitch the per-process output segments written by a
+// PACKET_FANOUT group of capture agents back into one dataset, ordered by
+// session start time. Segments may be JSON documents or NDJSON files (one
+// session per line); the output is always a JSON document. Binary segments
+// (output_format: segment) are turned into JSON by rewind-dump first.
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+    void printUsage(const char* programName) {
+        std::cout << "Usage: " << programName << " [options] <segment> [<segment> ...]\n"
+                  << "Options:\n"
+                  << "  -o, --output <file>  Write the merged sessions to <file> (default: stdout)\n"
+                  << "  --help               Show this help message\n";
+    }
+
+    // One session object per line. A last line without its newline is what
+    // an agent leaves when it dies mid-write; it is skipped, not an error.
+    bool loadNdjson(const std::string& path, std::istream& in, std::vector<nlohmann::json>& sessions) {
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            if (line.empty()) {
+                continue;
+            }
+
+            bool complete = !in.eof();
+            try {
+                sessions.push_back(nlohmann::json::parse(line));
+            }
+            catch (const std::exception& e) {
+                if (!complete) {
+                    std::cerr << path << ": skipping incomplete last line" << std::endl;
+                    break;
+                }
+                std::cerr << "Failed to parse " << path << " line " << lineNumber << ": " << e.what() << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // An NDJSON segment starts with a complete session object; a JSON
+    // document's first line is not a complete value on its own (or, when
+    // compact, carries the "sessions" array)
+    bool isNdjson(std::istream& in) {
+        std::string line;
+        while (std::getline(in, line) && line.empty()) {
+        }
+
+        bool ndjson = false;
+        try {
+            nlohmann::json first = nlohmann::json::parse(line);
+            ndjson = first.is_object() && !first.contains("sessions");
+        }
+        catch (const std::exception&) {
+        }
+
+        in.clear();
+        in.seekg(0);
+        return ndjson;
+    }
+
+    bool loadSessions(const std::string& path, std::vector<nlohmann::json>& sessions) {
+        if (std::filesystem::path(path).extension() == ".rwseg") {
+            std::cerr << path << " is a binary segment; convert segments with rewind-dump first "
+                      << "(rewind-dump -o sessions.json <segment|directory>)" << std::endl;
+            return false;
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Failed to open " << path << std::endl;
+            return false;
+        }
+
+        if (isNdjson(in)) {
+            return loadNdjson(path, in, sessions);
+        }
+
+        try {
+            nlohmann::json doc = nlohmann::json::parse(in);
+            if (!doc.contains("sessions") || !doc["sessions"].is_array()) {
+                std::cerr << path << ": missing \"sessions\" array" << std::endl;
+                return false;
+            }
+
+            for (auto& session : doc["sessions"]) {
+                sessions.push_back(std::move(session));
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Failed to parse " << path << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    double startTimeOf(const nlohmann::json& session) {
+        auto it = session.find("startTime");
+        return (it != session.end() && it->is_number()) ? it->get<double>() : 0.0;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string outputPath;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<nlohmann::json> sessions;
+    for (const auto& input : inputs) {
+        if (!loadSessions(input, sessions)) {
+            return 1;
+        }
+    }
+
+    // Fanout gives each flow to exactly one member, so merging is an ordering
+    // problem only; ties are broken by session id for a stable result
+    std::stable_sort(sessions.begin(), sessions.end(),
+        [](const nlohmann::json& a, const nlohmann::json& b) {
+            double startA = startTimeOf(a);
+            double startB = startTimeOf(b);
+            if (startA != startB) {
+                return startA < startB;
+            }
+            return a.value("sessionId", "") < b.value("sessionId", "");
+        });
+
+    nlohmann::json output;
+    output["sessionCount"] = sessions.size();
+    output["sessions"] = std::move(sessions);
+
+    if (outputPath.empty()) {
+        std::cout << output.dump(2) << std::endl;
+        return 0;
+    }
+
+    std::ofstream out(outputPath);
+    if (!out.is_open()) {
+        std::cerr << "Failed to open " << outputPath << std::endl;
+        return 1;
+    }
+    out << output.dump(2);
+
+    std::cerr << "Merged " << output["sessionCount"].get<size_t>() << " sessions from "
+              << inputs.size() << " segments into " << outputPath << std::endl;
+    return 0;
+}